@@ -0,0 +1,112 @@
+#pragma once
+//*****************************************//
+//  allocation_hook.hpp
+//
+//  Counts the heap allocations of a benchmark: each one calls
+//  on_allocation(), which the benchmark declares before including this
+//  file. With glibc, the whole malloc family is interposed, so that the
+//  allocations which bypass operator new are counted too. Elsewhere, only
+//  the global operator new and operator new[] are replaced: aligned
+//  allocations and direct calls to malloc are not counted.
+//
+//*****************************************//
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+static void on_allocation() noexcept;
+
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(std::size_t);
+void* __libc_calloc(std::size_t, std::size_t);
+void* __libc_realloc(void*, std::size_t);
+void* __libc_memalign(std::size_t, std::size_t);
+void* __libc_valloc(std::size_t);
+void* __libc_pvalloc(std::size_t);
+
+void* malloc(std::size_t size)
+{
+  on_allocation();
+  return __libc_malloc(size);
+}
+
+void* calloc(std::size_t count, std::size_t size)
+{
+  on_allocation();
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, std::size_t size)
+{
+  on_allocation();
+  return __libc_realloc(p, size);
+}
+
+void* memalign(std::size_t alignment, std::size_t size)
+{
+  on_allocation();
+  return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(std::size_t alignment, std::size_t size)
+{
+  on_allocation();
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** p, std::size_t alignment, std::size_t size)
+{
+  on_allocation();
+  *p = __libc_memalign(alignment, size);
+  return *p ? 0 : ENOMEM;
+}
+
+void* valloc(std::size_t size)
+{
+  on_allocation();
+  return __libc_valloc(size);
+}
+
+void* pvalloc(std::size_t size)
+{
+  on_allocation();
+  return __libc_pvalloc(size);
+}
+}
+#else
+void* operator new(std::size_t size)
+{
+  on_allocation();
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size)
+{
+  return ::operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+#endif
@@ -0,0 +1,173 @@
+//*****************************************//
+//  allocations.cpp
+//
+//  Checks that the steady-state data paths do not allocate: message
+//  construction, the input queue, callbacks, midi_out::send_message and
+//  parsing a MIDI file again. Each path is warmed up, then run while
+//  the heap allocations of the calling thread are counted.
+//
+//  Exits with a failure status if any path allocates. It is registered
+//  with ctest when the benchmarks are enabled, to guard changes to these
+//  paths.
+//
+//*****************************************//
+
+#include <cstdlib>
+
+#include <rtmidi17/rtmidi17.hpp>
+// Must come after the library in header-only mode
+#include <rtmidi17/detail/midi_api.hpp>
+#include <rtmidi17/reader.hpp>
+#include <rtmidi17/writer.hpp>
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Allocations made by each thread. Only those of the thread which runs
+// a path count, so that the other threads of the process cannot make it
+// fail; the loopback API calls the callbacks from the sending thread.
+static thread_local uint64_t allocations{};
+
+static void on_allocation() noexcept
+{
+  allocations++;
+}
+
+#include "allocation_hook.hpp"
+
+// Prevents the compiler from optimizing away the computation of a value
+template <typename T>
+static void escape(const T& value)
+{
+  static const void* volatile sink;
+  sink = &value;
+  (void)sink;
+}
+
+#if __has_include(<boost/container/small_vector.hpp>) && !defined(RTMIDI17_NO_BOOST)
+static const char* const bytes_type = "small_vector";
+#else
+static const char* const bytes_type = "std::vector";
+#endif
+
+static int failures = 0;
+
+template <typename F>
+static void check(const char* name, F&& f, uint64_t iterations = 100000)
+{
+  // Lets buffers and every slot of the queues reach their steady-state
+  // size.
+  for (uint64_t i = 0; i < 1000; i++)
+    f();
+
+  const auto before = allocations;
+  for (uint64_t i = 0; i < iterations; i++)
+    f();
+  const auto count = allocations - before;
+
+  if (count > 0)
+    failures++;
+  std::cout << std::left << std::setw(36) << name << std::right << std::setw(10) << count
+            << " allocations" << (count > 0 ? "  FAILED" : "") << std::endl;
+}
+
+int main()
+try
+{
+  std::cout << "midi_bytes: " << bytes_type << "\n\n";
+
+  // Message construction. Messages longer than the inline capacity of
+  // midi_bytes allocate by design, and with std::vector all do.
+  if (std::string{bytes_type} == "small_vector")
+  {
+    check("message::note_on", [] { escape(rtmidi::message::note_on(1, 60, 100)); });
+    check("message::control_change", [] {
+      escape(rtmidi::message::control_change(1, 7, 100));
+    });
+    check("message::pitch_bend", [] { escape(rtmidi::message::pitch_bend(1, 8192)); });
+  }
+
+  const auto note = rtmidi::message::note_on(1, 60, 100);
+
+  // Sending to an input with a callback
+  {
+    int sum = 0;
+    rtmidi::midi_in in{rtmidi::API::LOOPBACK, "rtmidi17-allocations-in"};
+    in.set_callback([&](const rtmidi::message& m) { sum += m.bytes[0]; });
+    in.open_virtual_port("in");
+    rtmidi::midi_out out{rtmidi::API::LOOPBACK, "rtmidi17-allocations-out"};
+    out.open_port(0);
+
+    const std::vector<unsigned char> vec{0x90, 60, 100};
+    check("send_message(bytes) -> callback", [&] { out.send_message(vec.data(), vec.size()); });
+    check("send_message(message) -> callback", [&] { out.send_message(note); });
+    check("schedule_message -> callback", [&] { out.schedule_message(0, note); });
+
+    const std::vector<rtmidi::message> batch(8, note);
+    check("send_messages(8) -> callback", [&] { out.send_messages(batch); });
+
+    // Messages dropped by the input filter
+    in.set_filter(rtmidi::input_filter{}.accept(rtmidi::message_type::CONTROL_CHANGE));
+    check("send_message -> filtered", [&] { out.send_message(note); });
+    escape(sum);
+  }
+
+  // Sending to an input without callback, which queues the messages
+  if (std::string{bytes_type} == "small_vector")
+  {
+    rtmidi::midi_in in{rtmidi::API::LOOPBACK, "rtmidi17-allocations-in"};
+    in.open_virtual_port("in");
+    rtmidi::midi_out out{rtmidi::API::LOOPBACK, "rtmidi17-allocations-out"};
+    out.open_port(0);
+
+    check("send_message -> queue -> get_message", [&] {
+      out.send_message(note);
+      escape(in.get_message());
+    });
+  }
+
+  // The queue itself, whose slots keep their memory with either midi_bytes
+  {
+    rtmidi::midi_in_api::midi_queue queue;
+    queue.ringSize = 128;
+    queue.ring = std::make_unique<rtmidi::message[]>(queue.ringSize);
+    rtmidi::message m;
+    check("midi_queue::push+pop", [&] {
+      queue.push(note);
+      queue.pop(m);
+      escape(m);
+    });
+  }
+
+  // Parsing the same file again, once the tracks have grown
+  if (std::string{bytes_type} == "small_vector")
+  {
+    rtmidi::writer w{480};
+    w.add_track();
+    for (int i = 0; i < 1024; i++)
+    {
+      w.add_event(0, 0, rtmidi::message::note_on(1 + i % 4, 60 + i % 12, 100));
+      w.add_event(120, 0, rtmidi::message::note_off(1 + i % 4, 60 + i % 12, 0));
+    }
+    std::ostringstream file;
+    w.write(file);
+    const std::string str = file.str();
+    const std::vector<uint8_t> buffer(str.begin(), str.end());
+
+    rtmidi::reader r{true};
+    check("reader::parse", [&] { r.parse(buffer); }, 1000);
+    escape(r.tracks);
+  }
+
+  std::cout << "\n" << (failures ? "FAILED: steady-state paths allocate" : "OK") << std::endl;
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+catch (const std::exception& e)
+{
+  std::cerr << e.what() << std::endl;
+  return EXIT_FAILURE;
+}
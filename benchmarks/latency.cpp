@@ -0,0 +1,283 @@
+//*****************************************//
+//  latency.cpp
+//
+//  Round-trip latency benchmark: sends probe messages through an
+//  output connected to a virtual input of the same process, and
+//  reports the latency distribution, jitter and loss.
+//
+//  For JACK, start a server with the dummy driver first, e.g.:
+//    jackd -d dummy -r 48000 -p 64
+//
+//*****************************************//
+
+#include <rtmidi17/rtmidi17.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using clk = std::chrono::steady_clock;
+
+struct options
+{
+  std::vector<rtmidi::API> apis;
+  double rate{1000.};
+  std::size_t size{3};
+  std::size_t count{10000};
+  bool json{};
+};
+
+static const std::map<std::string, rtmidi::API> api_names{
+    {"alsa", rtmidi::API::LINUX_ALSA},
+    {"jack", rtmidi::API::UNIX_JACK},
+    {"loopback", rtmidi::API::LOOPBACK},
+};
+
+static std::string api_name(rtmidi::API api)
+{
+  for (const auto& [name, a] : api_names)
+    if (a == api)
+      return name;
+  return "unknown";
+}
+
+[[noreturn]] static void usage()
+{
+  std::cout << "\nusage: rtmidi17_latency [options]\n"
+               "    --api alsa|jack|loopback  API to measure, repeatable (default: all)\n"
+               "    --rate N                  messages per second (default: 1000)\n"
+               "    --size N                  message size in bytes, 3 or >= 7 (default: 3)\n"
+               "    --count N                 number of messages (default: 10000)\n"
+               "    --json                    one JSON object per line on stdout\n\n";
+  exit(0);
+}
+
+static options parse(int argc, char** argv)
+{
+  options opt;
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--api" && has_value)
+    {
+      auto it = api_names.find(argv[++i]);
+      if (it == api_names.end())
+        usage();
+      opt.apis.push_back(it->second);
+    }
+    else if (arg == "--rate" && has_value)
+      opt.rate = std::atof(argv[++i]);
+    else if (arg == "--size" && has_value)
+      opt.size = std::strtoul(argv[++i], nullptr, 10);
+    else if (arg == "--count" && has_value)
+      opt.count = std::strtoul(argv[++i], nullptr, 10);
+    else if (arg == "--json")
+      opt.json = true;
+    else
+      usage();
+  }
+
+  if (opt.rate <= 0. || opt.count == 0 || (opt.size != 3 && opt.size < 7))
+    usage();
+
+  if (opt.apis.empty())
+  {
+    for (auto api : rtmidi::available_apis())
+      if (api == rtmidi::API::LINUX_ALSA || api == rtmidi::API::UNIX_JACK
+          || api == rtmidi::API::LOOPBACK)
+        opt.apis.push_back(api);
+  }
+  return opt;
+}
+
+// Probes carry their sequence number. Three-byte probes are note-on
+// messages with a 14-bit sequence number, larger ones are sysex messages
+// in the non-commercial range with a 28-bit sequence number.
+static void make_probe(rtmidi::message& m, std::size_t size, uint32_t seq)
+{
+  if (size == 3)
+  {
+    m.bytes = {0x90, uint8_t(seq & 0x7F), uint8_t((seq >> 7) & 0x7F)};
+    return;
+  }
+
+  m.bytes.assign(size, 0);
+  m.bytes[0] = 0xF0;
+  m.bytes[1] = 0x7D;
+  for (int i = 0; i < 4; i++)
+    m.bytes[2 + i] = (seq >> (7 * i)) & 0x7F;
+  m.bytes[size - 1] = 0xF7;
+}
+
+struct result
+{
+  std::size_t sent{};
+  std::size_t received{};
+  double p50{}, p99{}, p999{}, max{}, mean{}, jitter{};
+};
+
+static result run(rtmidi::API api, const options& opt)
+{
+  using namespace std::chrono;
+  const std::size_t count = opt.count;
+
+  // Send and receive times, in nanoseconds, indexed by sequence number.
+  std::vector<int64_t> sendTimes(count);
+  auto recvTimes = std::make_unique<std::atomic<int64_t>[]>(count);
+  for (std::size_t i = 0; i < count; i++)
+    recvTimes[i] = -1;
+  std::atomic<std::size_t> sent{};
+
+  const auto t0 = clk::now();
+  const auto now_ns = [t0] { return duration_cast<nanoseconds>(clk::now() - t0).count(); };
+
+  rtmidi::midi_in in{api, "rtmidi17-latency-in"};
+  in.ignore_types(false, true, true);
+  in.set_callback([&](const rtmidi::message& m) {
+    const auto t = now_ns();
+    const std::size_t n = sent.load(std::memory_order_acquire);
+    if (n == 0 || m.bytes.empty())
+      return;
+
+    std::size_t seq{};
+    if (m.bytes[0] == 0x90 && m.bytes.size() == 3)
+    {
+      // The most recent probe sent with these 14 bits
+      const std::size_t low = m.bytes[1] | (m.bytes[2] << 7);
+      seq = n - 1 - ((n - 1 - low) & 0x3FFF);
+    }
+    else if (m.bytes[0] == 0xF0 && m.bytes.size() >= 7)
+    {
+      for (int i = 0; i < 4; i++)
+        seq |= std::size_t(m.bytes[2 + i]) << (7 * i);
+    }
+    else
+    {
+      return;
+    }
+
+    if (seq < count)
+      recvTimes[seq].store(t, std::memory_order_relaxed);
+  });
+  in.open_virtual_port("probe");
+
+  rtmidi::midi_out out{api, "rtmidi17-latency-out"};
+  bool found = false;
+  for (unsigned int i = 0, n = out.get_port_count(); i < n; i++)
+  {
+    if (out.get_port_name(i).find("rtmidi17-latency-in") != std::string::npos)
+    {
+      out.open_port(i);
+      found = true;
+      break;
+    }
+  }
+  if (!found)
+    throw rtmidi::invalid_device_error("could not find the probe input port");
+
+  // Let the connection settle
+  std::this_thread::sleep_for(milliseconds(100));
+
+  rtmidi::message probe;
+  const auto period = duration<double>(1. / opt.rate);
+  const auto start = clk::now();
+  for (std::size_t i = 0; i < count; i++)
+  {
+    std::this_thread::sleep_until(start + duration_cast<clk::duration>(period * i));
+    make_probe(probe, opt.size, i);
+    sendTimes[i] = now_ns();
+    sent.store(i + 1, std::memory_order_release);
+    out.send_message(probe);
+  }
+
+  // Wait for the stragglers
+  std::this_thread::sleep_for(milliseconds(500));
+  in.cancel_callback();
+
+  result r;
+  r.sent = count;
+  std::vector<double> lat;
+  lat.reserve(count);
+  for (std::size_t i = 0; i < count; i++)
+  {
+    const auto t = recvTimes[i].load();
+    if (t >= 0)
+      lat.push_back((t - sendTimes[i]) / 1000.);
+  }
+  r.received = lat.size();
+  if (lat.empty())
+    return r;
+
+  // Jitter: mean absolute difference of the latency of consecutive probes
+  double jitter = 0.;
+  for (std::size_t i = 1; i < lat.size(); i++)
+    jitter += std::abs(lat[i] - lat[i - 1]);
+  r.jitter = lat.size() > 1 ? jitter / (lat.size() - 1) : 0.;
+  r.mean = std::accumulate(lat.begin(), lat.end(), 0.) / lat.size();
+
+  std::sort(lat.begin(), lat.end());
+  const auto pct = [&](double p) {
+    return lat[std::min(lat.size() - 1, std::size_t(std::ceil(p * lat.size())) - 1)];
+  };
+  r.p50 = pct(0.5);
+  r.p99 = pct(0.99);
+  r.p999 = pct(0.999);
+  r.max = lat.back();
+  return r;
+}
+
+int main(int argc, char** argv)
+try
+{
+  const auto opt = parse(argc, argv);
+
+  for (auto api : opt.apis)
+  {
+    result r;
+    try
+    {
+      r = run(api, opt);
+    }
+    catch (const rtmidi::midi_exception& e)
+    {
+      std::cerr << api_name(api) << ": " << e.what() << '\n';
+      continue;
+    }
+
+    const auto lost = r.sent - r.received;
+    if (opt.json)
+    {
+      std::cout << "{\"api\":\"" << api_name(api) << "\",\"rate\":" << opt.rate
+                << ",\"size\":" << opt.size << ",\"sent\":" << r.sent
+                << ",\"received\":" << r.received << ",\"lost\":" << lost
+                << ",\"p50_us\":" << r.p50 << ",\"p99_us\":" << r.p99
+                << ",\"p999_us\":" << r.p999 << ",\"max_us\":" << r.max
+                << ",\"mean_us\":" << r.mean << ",\"jitter_us\":" << r.jitter << "}"
+                << std::endl;
+    }
+    else
+    {
+      std::cout << api_name(api) << ": " << r.received << "/" << r.sent << " received ("
+                << lost << " lost)\n"
+                << "  latency (us): p50 " << r.p50 << ", p99 " << r.p99 << ", p99.9 " << r.p999
+                << ", max " << r.max << ", mean " << r.mean << "\n"
+                << "  jitter (us): " << r.jitter << std::endl;
+    }
+  }
+  return 0;
+}
+catch (const rtmidi::midi_exception& e)
+{
+  std::cerr << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,341 @@
+//*****************************************//
+//  throughput.cpp
+//
+//  Microbenchmarks of the core data paths: message factories, the
+//  input queue, callback invocation, input filtering,
+//  midi_out::send_message, the scheduler and the router.
+//  Reports the time and the number of heap allocations per operation.
+//
+//  The benchmark is built once with the default midi_bytes type and
+//  once with RTMIDI17_NO_BOOST, to compare small_vector and std::vector,
+//  and once with RTMIDI17_NO_STATISTICS, to measure the cost of the
+//  per-port statistics.
+//
+//*****************************************//
+
+#include <rtmidi17/rtmidi17.hpp>
+// Must come after the library in header-only mode
+#include <rtmidi17/detail/midi_api.hpp>
+#include <rtmidi17/note_tracker.hpp>
+#include <rtmidi17/router.hpp>
+#include <rtmidi17/scheduler.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+
+static std::atomic<uint64_t> allocations{};
+
+static void on_allocation() noexcept
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+#include "allocation_hook.hpp"
+
+// Prevents the compiler from optimizing away the computation of a value
+template <typename T>
+static void escape(const T& value)
+{
+  static const void* volatile sink;
+  sink = &value;
+  (void)sink;
+}
+
+static bool json = false;
+
+#if __has_include(<boost/container/small_vector.hpp>) && !defined(RTMIDI17_NO_BOOST)
+static const char* const bytes_type = "small_vector";
+#else
+static const char* const bytes_type = "std::vector";
+#endif
+
+template <typename F>
+static void bench(const char* name, F&& f)
+{
+  using namespace std::chrono;
+  constexpr uint64_t iterations = 1000000;
+
+  for (uint64_t i = 0; i < iterations / 10; i++)
+    f();
+
+  const auto allocs = allocations.load();
+  const auto start = steady_clock::now();
+  for (uint64_t i = 0; i < iterations; i++)
+    f();
+  const auto end = steady_clock::now();
+
+  const double ns = duration<double, std::nano>(end - start).count() / iterations;
+  const double allocs_per_op = double(allocations.load() - allocs) / iterations;
+
+  if (json)
+  {
+    std::cout << "{\"benchmark\":\"" << name << "\",\"midi_bytes\":\"" << bytes_type
+              << "\",\"ns_per_op\":" << ns << ",\"allocs_per_op\":" << allocs_per_op << "}"
+              << std::endl;
+  }
+  else
+  {
+    std::cout << std::left << std::setw(36) << name << std::right << std::setw(10)
+              << std::fixed << std::setprecision(2) << ns << " ns/op" << std::setw(10)
+              << allocs_per_op << " allocs/op" << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+try
+{
+  json = argc > 1 && std::string{argv[1]} == "--json";
+  if (!json)
+    std::cout << "midi_bytes: " << bytes_type << "\n\n";
+
+  // Message factories
+  bench("message::note_on", [] { escape(rtmidi::message::note_on(1, 60, 100)); });
+  bench("message::control_change", [] { escape(rtmidi::message::control_change(1, 7, 100)); });
+  bench("message::pitch_bend", [] { escape(rtmidi::message::pitch_bend(1, 8192)); });
+  bench("message::sysex(16)", [] {
+    rtmidi::message m;
+    m.bytes.assign(16, 0);
+    m.bytes.front() = 0xF0;
+    m.bytes.back() = 0xF7;
+    escape(m);
+  });
+
+  // Input queue
+  {
+    rtmidi::midi_in_api::midi_queue queue;
+    queue.ringSize = 128;
+    queue.ring = std::make_unique<rtmidi::message[]>(queue.ringSize);
+    const auto note = rtmidi::message::note_on(1, 60, 100);
+    rtmidi::message out;
+    bench("midi_queue::push+pop", [&] {
+      queue.push(note);
+      queue.pop(out);
+      escape(out);
+    });
+  }
+
+  // Callback invocation
+  {
+    int sum = 0;
+    rtmidi::midi_in::message_callback cb = [&](const rtmidi::message& m) { sum += m.bytes[0]; };
+    const auto note = rtmidi::message::note_on(1, 60, 100);
+    bench("std::function callback", [&] { cb(note); });
+    escape(sum);
+  }
+
+  // Reassembly of a 4 KiB sysex received in parts of 256 bytes, as
+  // ALSA segments them
+  {
+    rtmidi::sysex_assembler sysex;
+    std::vector<unsigned char> dump(4096, 0x42);
+    dump.front() = 0xF0;
+    dump.back() = 0xF7;
+    std::size_t total = 0;
+    bench("sysex_assembler::feed(4096 / 256)", [&] {
+      for (std::size_t i = 0; i < dump.size(); i += 256)
+        sysex.feed(1, dump.data() + i, 256, 0, 1, [&](rtmidi::message& m, uint8_t) {
+          total += m.bytes.size();
+        });
+    });
+    escape(total);
+  }
+
+  // Note state updates, from random notes on and off
+  {
+    rtmidi::note_tracker notes;
+    std::mt19937 rng{1234};
+    std::vector<rtmidi::message> stream(4096);
+    for (auto& m : stream)
+      m = rng() % 2 ? rtmidi::message::note_on(1 + rng() % 16, rng() % 128, 1 + rng() % 127)
+                    : rtmidi::message::note_off(1 + rng() % 16, rng() % 128, 0);
+    std::size_t i = 0;
+    bench("note_tracker::process", [&] {
+      const auto& m = stream[i++ % stream.size()];
+      notes.process(m.bytes.data(), m.bytes.size(), int64_t(i));
+    });
+    escape(notes.count());
+  }
+
+  // Statistics of a port, for each message
+  {
+    rtmidi::port_counters counters;
+    bench("port_counters::start+processed", [&] {
+      counters.processed(3, counters.start());
+    });
+    escape(counters.snapshot().messages);
+  }
+
+  // Sending, through the loopback API with nothing connected
+  {
+    rtmidi::midi_out out{rtmidi::API::LOOPBACK, "rtmidi17-throughput"};
+    const std::vector<unsigned char> vec{0x90, 60, 100};
+    const auto note = rtmidi::message::note_on(1, 60, 100);
+    bench("midi_out::send_message(vector)", [&] { out.send_message(vec); });
+    bench("midi_out::send_message(message)", [&] { out.send_message(note); });
+  }
+
+  // Full path from midi_out to a midi_in callback
+  {
+    int sum = 0;
+    rtmidi::midi_in in{rtmidi::API::LOOPBACK, "rtmidi17-throughput-in"};
+    in.set_callback([&](const rtmidi::message& m) { sum += m.bytes[0]; });
+    in.open_virtual_port("in");
+
+    rtmidi::midi_out out{rtmidi::API::LOOPBACK, "rtmidi17-throughput-out"};
+    out.open_port(0);
+    const auto note = rtmidi::message::note_on(1, 60, 100);
+    bench("loopback send+callback", [&] { out.send_message(note); });
+
+    // Aftertouch dropped by the input filter, before any copy
+    const unsigned char pressure[2]{0xD0, 64};
+    bench("loopback send, unfiltered pressure", [&] { out.send_message(pressure, 2); });
+    in.set_filter(rtmidi::input_filter{}.accept(rtmidi::message_type::AFTERTOUCH, false));
+    bench("loopback send, filtered pressure", [&] { out.send_message(pressure, 2); });
+    escape(sum);
+  }
+
+  // Thru from an input to another loopback input, against forwarding from
+  // the input callback.
+  {
+    int sum = 0;
+    rtmidi::midi_in in{rtmidi::API::LOOPBACK, "rtmidi17-throughput-in"};
+    in.open_virtual_port("in");
+    rtmidi::midi_in target{rtmidi::API::LOOPBACK, "rtmidi17-throughput-target"};
+    target.set_callback([&](const rtmidi::message& m) { sum += m.bytes[0]; });
+    target.open_virtual_port("target");
+
+    rtmidi::midi_out out{rtmidi::API::LOOPBACK, "rtmidi17-throughput-out"};
+    out.open_port(0);
+    rtmidi::midi_out forward{rtmidi::API::LOOPBACK, "rtmidi17-throughput-forward"};
+    forward.open_port(1);
+
+    const auto note = rtmidi::message::note_on(1, 60, 100);
+    in.set_callback([&](const rtmidi::message& m) { forward.send_message(m); });
+    bench("loopback forward from callback", [&] { out.send_message(note); });
+    in.set_callback([&](const rtmidi::message& m) { sum += m.bytes[1]; });
+
+    in.add_thru(forward);
+    bench("loopback thru", [&] { out.send_message(note); });
+    in.add_thru(forward, rtmidi::input_filter::all(), [](rtmidi::message& m) {
+      m.bytes[1] += 12;
+      return true;
+    });
+    bench("loopback thru, transposed", [&] { out.send_message(note); });
+    in.remove_thru(forward);
+    escape(sum);
+  }
+
+  // Future events, with many others pending: the scheduler's timing wheel
+  // against a binary heap.
+  {
+    constexpr int pending = 50000;
+    std::mt19937 rng{1234};
+    const auto note = rtmidi::message::note_on(1, 60, 100);
+
+    rtmidi::scheduler sched;
+    rtmidi::midi_out out{rtmidi::API::LOOPBACK, "rtmidi17-throughput-sched"};
+    const int64_t start = sched.now() + 3600 * int64_t(1000000);
+    std::vector<rtmidi::scheduler::event_id> ids;
+    for (int i = 0; i < pending; i++)
+      ids.push_back(sched.schedule(out, start + rng() % 60000000, note));
+    std::size_t i = 0;
+    bench("scheduler schedule+cancel", [&] {
+      sched.cancel(ids[i]);
+      ids[i] = sched.schedule(out, start + rng() % 60000000, note);
+      i = (i + 1) % pending;
+    });
+    sched.cancel(out);
+
+    using entry = std::pair<int64_t, rtmidi::message>;
+    const auto later = [](const entry& lhs, const entry& rhs) { return lhs.first > rhs.first; };
+    std::priority_queue<entry, std::vector<entry>, decltype(later)> heap{later};
+    for (int k = 0; k < pending; k++)
+      heap.emplace(start + rng() % 60000000, note);
+    bench("priority_queue push+pop", [&] {
+      heap.emplace(start + rng() % 60000000, note);
+      heap.pop();
+    });
+  }
+
+  // Routing one input to many outputs through a transform, against a
+  // route table guarded by a mutex. The last case commits changes to
+  // the graph continuously from another thread while routing.
+  {
+    const auto note = rtmidi::message::note_on(1, 60, 100);
+    std::vector<std::unique_ptr<rtmidi::midi_out>> outs;
+    for (int i = 0; i < 128; i++)
+      outs.push_back(std::make_unique<rtmidi::midi_out>(
+          rtmidi::API::LOOPBACK, "rtmidi17-throughput-router"));
+
+    for (int fanout : {1, 16, 128})
+    {
+      rtmidi::router router;
+      const auto in = router.add_input();
+      const auto transpose = router.add_transform([](rtmidi::message& m) {
+        m.bytes[1] += 12;
+        return true;
+      });
+      router.connect(in, transpose);
+      for (int i = 0; i < fanout; i++)
+        router.connect(transpose, router.add_output(*outs[i]));
+      router.commit();
+
+      const std::string name = "router route, fan-out " + std::to_string(fanout);
+      bench(name.c_str(), [&] { router.route(in, note); });
+
+      std::mutex mutex;
+      std::vector<rtmidi::midi_out*> table;
+      for (int i = 0; i < fanout; i++)
+        table.push_back(outs[i].get());
+      const std::string locked = "mutex route table, fan-out " + std::to_string(fanout);
+      bench(locked.c_str(), [&] {
+        std::lock_guard<std::mutex> lock{mutex};
+        auto m = note;
+        m.bytes[1] += 12;
+        for (auto out : table)
+          out->send_message(m);
+      });
+    }
+
+    {
+      rtmidi::router router;
+      const auto in = router.add_input();
+      for (int i = 0; i < 16; i++)
+        router.connect(in, router.add_output(*outs[i]));
+      const auto spare = router.add_output(*outs[16]);
+      router.commit();
+
+      std::atomic_bool done{};
+      std::thread editor{[&] {
+        while (!done)
+        {
+          const auto t = router.add_transform([](rtmidi::message&) { return true; });
+          router.connect(in, t);
+          router.connect(t, spare);
+          router.commit();
+          router.remove(t);
+          router.commit();
+        }
+      }};
+      bench("router route, fan-out 16, commits", [&] { router.route(in, note); });
+      done = true;
+      editor.join();
+    }
+  }
+
+  return 0;
+}
+catch (const rtmidi::midi_exception& e)
+{
+  std::cerr << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,140 @@
+#if !defined(RTMIDI17_HEADER_ONLY)
+#  include <rtmidi17/clock_follower.hpp>
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+namespace rtmidi
+{
+RTMIDI17_INLINE
+void clock_follower::set_gain(double gain) noexcept
+{
+  gain_ = std::clamp(gain, 0.001, 1.);
+}
+
+RTMIDI17_INLINE
+void clock_follower::process(const message& m)
+{
+  // Back-ends which do not provide an absolute time only give deltas.
+  lastTime_ += int64_t(m.timestamp * 1e6);
+  process(m, m.absolute_time != 0 ? m.absolute_time : lastTime_);
+}
+
+RTMIDI17_INLINE
+void clock_follower::process(const message& m, int64_t time)
+{
+  if (resetRequested_.exchange(false, std::memory_order_acquire))
+    clear();
+
+  if (m.bytes.empty())
+    return;
+
+  switch (message_type(m.bytes[0]))
+  {
+    case message_type::TIME_CLOCK:
+      on_clock(time);
+      return;
+    case message_type::START:
+      current_.playing = true;
+      nextPosition_ = 0;
+      current_.position = 0;
+      break;
+    case message_type::CONTINUE:
+      current_.playing = true;
+      break;
+    case message_type::STOP:
+      current_.playing = false;
+      break;
+    case message_type::SONG_POS_POINTER:
+      if (m.bytes.size() < 3)
+        return;
+      // Song position pointers count sixteenth notes, i.e. 6 clocks.
+      nextPosition_ = 6 * (m.bytes[1] | (m.bytes[2] << 7));
+      current_.position = nextPosition_;
+      break;
+    default:
+      return;
+  }
+  publish();
+}
+
+RTMIDI17_INLINE
+void clock_follower::reset() noexcept
+{
+  resetRequested_.store(true, std::memory_order_release);
+}
+
+RTMIDI17_INLINE
+void clock_follower::clear()
+{
+  current_ = {};
+  nextPosition_ = 0;
+  updates_ = 0;
+  publish();
+}
+
+RTMIDI17_INLINE
+void clock_follower::on_clock(int64_t time)
+{
+  int64_t elapsed = 1;
+  if (updates_ == 0)
+  {
+    estimate_ = time;
+    updates_ = 1;
+  }
+  else if (updates_ == 1)
+  {
+    period_ = time - estimate_;
+    estimate_ = time;
+    updates_ = period_ > 0. ? 2 : 1;
+  }
+  else
+  {
+    const double intervals = (time - estimate_) / period_;
+    if (intervals < 0.5 || intervals > 16.)
+    {
+      // The source of the clock restarted or changed abruptly: start over.
+      estimate_ = time;
+      updates_ = 1;
+      current_.locked = false;
+    }
+    else
+    {
+      // More than one interval elapsed if clocks were lost.
+      elapsed = std::max(int64_t(1), int64_t(std::lround(intervals)));
+      const double error = time - (estimate_ + elapsed * period_);
+
+      // Faster convergence for the first clocks
+      const double alpha = std::max(gain_, 2. / (updates_ + 1));
+      const double beta = alpha * alpha / (2. - alpha);
+      estimate_ += elapsed * period_ + alpha * error;
+      period_ += beta * error / elapsed;
+      updates_++;
+    }
+  }
+
+  if (current_.playing)
+  {
+    nextPosition_ += elapsed - 1;
+    current_.position = nextPosition_++;
+    current_.phase = (current_.position % 24) / 24.;
+  }
+
+  if (updates_ >= 2)
+  {
+    current_.period = period_;
+    current_.bpm = 60e6 / (period_ * 24.);
+    current_.next_tick = int64_t(estimate_ + period_);
+    current_.locked = updates_ >= 4;
+  }
+  current_.last_tick = int64_t(estimate_);
+  publish();
+}
+
+RTMIDI17_INLINE
+void clock_follower::publish()
+{
+  shared_.store(current_);
+}
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <rtmidi17/detail/seqlock.hpp>
+#include <rtmidi17/rtmidi17.hpp>
+
+namespace rtmidi
+{
+//! A snapshot of the state of a clock_follower. Times are in
+//! microseconds, on the clock of the midi_in back-end.
+struct clock_follower_state
+{
+  double bpm{};          //!< Estimated tempo, in quarter notes per minute
+  double period{};       //!< Estimated interval between two clocks
+  int64_t last_tick{};   //!< Estimated time of the last clock
+  int64_t next_tick{};   //!< Predicted time of the next clock
+  int64_t position{};    //!< Song position of the last clock, in clocks (24 per quarter)
+  double phase{};        //!< Position of the last clock within its beat, in [0, 1)
+  bool playing{};        //!< Between a START or CONTINUE and a STOP
+  bool locked{};         //!< Whether enough clocks were received for the estimate to be valid
+
+  //! Song position extrapolated to the given time, in quarter notes.
+  double position_at(int64_t time) const noexcept
+  {
+    if (!locked || period <= 0.)
+      return position / 24.;
+    return (position + (time - last_tick) / period) / 24.;
+  }
+};
+
+/**********************************************************************/
+/*! \class clock_follower
+    \brief Follows the MIDI clock received on a midi_in.
+
+    Feed it all the messages of an input from its callback, without
+    ignoring timing messages:
+
+    \code
+    rtmidi::clock_follower follower;
+    midiin.ignore_types(true, false, true);
+    midiin.set_callback([&](const rtmidi::message& m) { follower.process(m); });
+    \endcode
+
+    The tempo is estimated by a second-order tracking loop (an alpha-beta
+    filter, i.e. the steady-state Kalman filter of a constant tempo
+    model) which smooths the jitter of the clock messages. Missing
+    clocks are detected and accounted for.
+
+    process() must always be called from the same thread. state() and
+    reset() can be called from any thread, including real-time ones: they
+    never block.
+*/
+/**********************************************************************/
+class RTMIDI17_EXPORT clock_follower
+{
+public:
+  clock_follower() = default;
+
+  //! Gain of the tracking loop in (0, 1]: lower values smooth more, but
+  //! follow tempo changes more slowly. Defaults to 0.05.
+  void set_gain(double gain) noexcept;
+
+  //! Processes a message. Messages other than clock, start, stop,
+  //! continue and song position pointer are ignored.
+  void process(const message& m);
+
+  //! Processes a message received at the given time, in microseconds.
+  void process(const message& m, int64_t time);
+
+  //! Forgets the tempo estimate and the transport state. Can be called
+  //! from any thread: the thread calling process() resets the state when
+  //! it processes the next message.
+  void reset() noexcept;
+
+  //! The current state. Lock-free.
+  clock_follower_state state() const noexcept
+  {
+    return shared_.load();
+  }
+
+  //! The current estimated tempo. Lock-free.
+  double bpm() const noexcept
+  {
+    return state().bpm;
+  }
+
+private:
+  void on_clock(int64_t time);
+  void clear();
+  void publish();
+
+  double gain_{0.05};
+  std::atomic<bool> resetRequested_{};
+
+  // Only accessed from the thread calling process()
+  clock_follower_state current_{};
+  double estimate_{}; // filtered time of the last clock
+  double period_{};
+  int64_t nextPosition_{};
+  int64_t lastTime_{};
+  uint64_t updates_{};
+
+  seqlock<clock_follower_state> shared_;
+};
+}
+
+#if defined(RTMIDI17_HEADER_ONLY)
+#  include <rtmidi17/clock_follower.cpp>
+#endif
@@ -0,0 +1,290 @@
+#if !defined(RTMIDI17_HEADER_ONLY)
+#  include <rtmidi17/clock_generator.hpp>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+
+#if defined(__linux__)
+#  include <time.h>
+#endif
+
+namespace rtmidi
+{
+namespace util
+{
+//! Nanoseconds on the monotonic clock
+inline int64_t monotonic_now() noexcept
+{
+#if defined(__linux__)
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+//! The periods are computed from the tempo, which must thus be usable as a
+//! divisor.
+inline void check_tempo(double bpm)
+{
+  if (!std::isfinite(bpm) || bpm <= 0.)
+    throw invalid_parameter_error{"clock_generator: the tempo must be positive and finite"};
+}
+}
+
+RTMIDI17_INLINE
+clock_generator::clock_generator(midi_out& out, double bpm)
+    : out_{out}, targetTempo_{bpm}, tempo_{bpm}
+{
+  util::check_tempo(bpm);
+  thread_ = std::thread{[this] { run(); }};
+}
+
+RTMIDI17_INLINE
+clock_generator::~clock_generator()
+{
+  running_ = false;
+  thread_.join();
+}
+
+RTMIDI17_INLINE
+void clock_generator::set_tempo(double bpm)
+{
+  util::check_tempo(bpm);
+  std::lock_guard<std::mutex> lock{mutex_};
+  targetTempo_ = bpm;
+  rampStep_ = 0.;
+  tempo_ = bpm;
+}
+
+RTMIDI17_INLINE
+void clock_generator::ramp_tempo(double bpm, double quarters)
+{
+  util::check_tempo(bpm);
+  const double clocks = quarters * 24.;
+  if (!(clocks >= 1.))
+  {
+    set_tempo(bpm);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock{mutex_};
+  targetTempo_ = bpm;
+  rampStep_ = (bpm - tempo_) / clocks;
+}
+
+RTMIDI17_INLINE
+double clock_generator::get_tempo() const noexcept
+{
+  return tempo_;
+}
+
+RTMIDI17_INLINE
+void clock_generator::start()
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  commands_.emplace_back(command::start, 0);
+}
+
+RTMIDI17_INLINE
+void clock_generator::stop()
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  commands_.emplace_back(command::stop, 0);
+}
+
+RTMIDI17_INLINE
+void clock_generator::resume()
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  commands_.emplace_back(command::resume, 0);
+}
+
+RTMIDI17_INLINE
+void clock_generator::set_song_position(int sixteenths)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  commands_.emplace_back(command::song_position, std::clamp(sixteenths, 0, 0x3FFF));
+}
+
+RTMIDI17_INLINE
+int clock_generator::get_song_position() const noexcept
+{
+  // There are 6 clocks per sixteenth note.
+  return position_ / 6;
+}
+
+RTMIDI17_INLINE
+bool clock_generator::is_playing() const noexcept
+{
+  return playing_;
+}
+
+RTMIDI17_INLINE
+void clock_generator::set_clock_while_stopped(bool enable)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  clockWhileStopped_ = enable;
+}
+
+RTMIDI17_INLINE
+void clock_generator::set_spin_time(std::chrono::microseconds spin)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  spin_ = spin;
+}
+
+RTMIDI17_INLINE
+clock_stats clock_generator::get_stats() const
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto s = stats_;
+  if (s.ticks > 0)
+  {
+    s.mean_error = errorSum_ / s.ticks;
+    const double variance = errorSquares_ / s.ticks - s.mean_error * s.mean_error;
+    s.stddev_error = std::sqrt(std::max(0., variance));
+  }
+  return s;
+}
+
+RTMIDI17_INLINE
+void clock_generator::reset_stats()
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  stats_ = {};
+  errorSum_ = 0.;
+  errorSquares_ = 0.;
+}
+
+RTMIDI17_INLINE
+void clock_generator::wait_until(int64_t deadline) const
+{
+  int64_t spin;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    spin = spin_.count();
+  }
+
+  // Sleep until shortly before the deadline...
+  const int64_t wake = deadline - spin;
+  if (util::monotonic_now() < wake)
+  {
+#if defined(__linux__)
+    timespec ts;
+    ts.tv_sec = wake / 1000000000;
+    ts.tv_nsec = wake % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+      ;
+#else
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point{
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::nanoseconds{wake})}});
+#endif
+  }
+
+  // ... then spin for the rest of the way.
+  while (util::monotonic_now() < deadline)
+    ;
+}
+
+RTMIDI17_INLINE
+void clock_generator::run()
+{
+  // Deadlines are kept in floating point nanoseconds since the start, so
+  // that the rounding of the periods does not accumulate either.
+  const int64_t start = util::monotonic_now();
+  double next = 0.;
+  while (running_)
+  {
+    const int64_t deadline = start + int64_t(next);
+    wait_until(deadline);
+    tick(deadline);
+
+    // 24 clocks per quarter note. The tempo was checked when set, and a
+    // ramp stops at its target.
+    next += 60e9 / (tempo_ * 24.);
+  }
+}
+
+RTMIDI17_INLINE
+void clock_generator::tick(int64_t deadline)
+{
+  std::vector<std::pair<command, int>> commands;
+  bool clockWhileStopped{};
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    commands.swap(commands_);
+    clockWhileStopped = clockWhileStopped_;
+
+    if (rampStep_ != 0.)
+    {
+      double tempo = tempo_ + rampStep_;
+      if ((rampStep_ > 0. && tempo >= targetTempo_) || (rampStep_ < 0. && tempo <= targetTempo_))
+      {
+        tempo = targetTempo_;
+        rampStep_ = 0.;
+      }
+      tempo_ = tempo;
+    }
+  }
+
+  const auto send = [this](auto... bytes) {
+    const unsigned char m[]{uint8_t(bytes)...};
+    out_.send_message(m, sizeof(m));
+  };
+
+  for (const auto& [cmd, value] : commands)
+  {
+    switch (cmd)
+    {
+      case command::start:
+        position_ = 0;
+        playing_ = true;
+        send(message_type::START);
+        break;
+      case command::stop:
+        if (playing_)
+        {
+          playing_ = false;
+          send(message_type::STOP);
+        }
+        break;
+      case command::resume:
+        if (!playing_)
+        {
+          playing_ = true;
+          send(message_type::CONTINUE);
+        }
+        break;
+      case command::song_position:
+        if (!playing_)
+        {
+          position_ = value * 6;
+          send(message_type::SONG_POS_POINTER, value & 0x7F, (value >> 7) & 0x7F);
+        }
+        break;
+    }
+  }
+
+  if (!playing_ && !clockWhileStopped)
+    return;
+
+  const int64_t lateness = util::monotonic_now() - deadline;
+  send(message_type::TIME_CLOCK);
+  if (playing_)
+    position_++;
+
+  const double error = lateness / 1000.;
+  std::lock_guard<std::mutex> lock{mutex_};
+  stats_.ticks++;
+  stats_.max_error = std::max(stats_.max_error, error);
+  errorSum_ += error;
+  errorSquares_ += error * error;
+}
+}
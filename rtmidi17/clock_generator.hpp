@@ -0,0 +1,129 @@
+#pragma once
+#include <rtmidi17/rtmidi17.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rtmidi
+{
+//! Timing statistics of a clock_generator.
+//! The lateness is the delay between the deadline of a clock message
+//! and the moment it is sent, in microseconds.
+struct clock_stats
+{
+  uint64_t ticks{};      //!< Number of clock messages sent
+  double mean_error{};   //!< Mean lateness
+  double stddev_error{}; //!< Standard deviation of the lateness
+  double max_error{};    //!< Maximum lateness
+};
+
+/**********************************************************************/
+/*! \class clock_generator
+    \brief Sends MIDI clock on a midi_out from a dedicated thread.
+
+    Each clock message is sent at an absolute deadline on the monotonic
+    clock, computed from the start of the generator and the tempo, so
+    that neither the wake-up latency nor the time spent sending
+    accumulates over time. The thread sleeps until shortly before each
+    deadline and busy-waits for the rest of the way.
+
+    Start, stop, continue and song position pointer messages are sent
+    by the clock thread as well, right before the next clock.
+
+    The midi_out must not be used by other threads while the generator
+    runs.
+*/
+/**********************************************************************/
+class RTMIDI17_EXPORT clock_generator
+{
+public:
+  //! Starts sending clock at the given tempo, in quarter notes per minute.
+  //! Tempos which are not positive and finite throw invalid_parameter_error,
+  //! here and when changing the tempo.
+  explicit clock_generator(midi_out& out, double bpm = 120.);
+  ~clock_generator();
+
+  clock_generator(const clock_generator&) = delete;
+  clock_generator(clock_generator&&) = delete;
+  clock_generator& operator=(const clock_generator&) = delete;
+  clock_generator& operator=(clock_generator&&) = delete;
+
+  //! Changes the tempo from the next clock on.
+  void set_tempo(double bpm);
+
+  //! Changes the tempo linearly, clock after clock, until it reaches
+  //! the given value after the given number of quarter notes.
+  void ramp_tempo(double bpm, double quarters);
+
+  //! Current tempo, in quarter notes per minute.
+  double get_tempo() const noexcept;
+
+  //! Sends START and plays from the beginning of the song.
+  void start();
+
+  //! Sends STOP. The song position is kept.
+  void stop();
+
+  //! Sends CONTINUE and plays from the current song position.
+  void resume();
+
+  //! Sends a song position pointer, in sixteenth notes. Only effective
+  //! while stopped.
+  void set_song_position(int sixteenths);
+
+  //! Current song position, in sixteenth notes.
+  int get_song_position() const noexcept;
+
+  bool is_playing() const noexcept;
+
+  //! Whether clock messages are also sent while stopped (the default),
+  //! which lets receivers measure the tempo ahead of the start.
+  void set_clock_while_stopped(bool enable);
+
+  //! Time before each deadline during which the thread busy-waits
+  //! instead of sleeping. Defaults to 200 microseconds.
+  void set_spin_time(std::chrono::microseconds spin);
+
+  clock_stats get_stats() const;
+  void reset_stats();
+
+private:
+  enum class command : uint8_t
+  {
+    start,
+    stop,
+    resume,
+    song_position
+  };
+
+  void run();
+  void tick(int64_t deadline);
+  void wait_until(int64_t deadline) const;
+
+  midi_out& out_;
+  std::thread thread_;
+  std::atomic_bool running_{true};
+
+  // Protected by mutex_
+  mutable std::mutex mutex_;
+  std::vector<std::pair<command, int>> commands_;
+  double targetTempo_{};
+  double rampStep_{};
+  bool clockWhileStopped_{true};
+  std::chrono::nanoseconds spin_{std::chrono::microseconds(200)};
+  clock_stats stats_{};
+  double errorSum_{};
+  double errorSquares_{};
+
+  std::atomic<double> tempo_{};
+  std::atomic<int> position_{}; // in clocks
+  std::atomic_bool playing_{};
+};
+}
+
+#if defined(RTMIDI17_HEADER_ONLY)
+#  include <rtmidi17/clock_generator.cpp>
+#endif
@@ -82,6 +82,7 @@ struct alsa_data
   pthread_t dummy_thread_id{};
   snd_seq_real_time_t lastTime{};
   int queue_id{}; // an input queue is needed to get timestamped events
+  int64_t queueOrigin{}; // time zero of the input queue, in nanoseconds on the steady clock
   int trigger_fds[2]{};
   std::vector<unsigned char> buffer;
 };
@@ -420,11 +421,8 @@ public:
 
     if (inputData_.doInput == false)
     {
-      // Start the input queue
-#ifndef AVOID_TIMESTAMPING
-      snd_seq_start_queue(data.seq, data.queue_id, nullptr);
-      snd_seq_drain_output(data.seq);
-#endif
+      start_queue();
+
       // Start our MIDI input thread.
       pthread_attr_t attr;
       pthread_attr_init(&attr);
@@ -480,11 +478,8 @@ public:
       if (!pthread_equal(data.thread, data.dummy_thread_id))
         pthread_join(data.thread, nullptr);
 
-        // Start the input queue
-#ifndef AVOID_TIMESTAMPING
-      snd_seq_start_queue(data.seq, data.queue_id, nullptr);
-      snd_seq_drain_output(data.seq);
-#endif
+      start_queue();
+
       // Start our MIDI input thread.
       pthread_attr_t attr;
       pthread_attr_init(&attr);
@@ -512,6 +507,8 @@ public:
   {
     if (connected_)
     {
+      // The native thru routes start from the port being closed.
+      unroute_native_thru();
       if (data.subscription)
       {
         snd_seq_unsubscribe_port(data.seq, data.subscription);
@@ -588,14 +585,150 @@ public:
   }
 
 private:
+  //! The status byte of the MIDI message an event decodes to, and its
+  //! first data byte for the messages which have one, or zero for events
+  //! which are not MIDI messages.
+  static uint8_t event_status(const snd_seq_event_t& ev, uint8_t& data1) noexcept
+  {
+    const auto note = [&](uint8_t status) {
+      data1 = ev.data.note.note;
+      return uint8_t(status | (ev.data.note.channel & 0x0F));
+    };
+    const auto control = [&](uint8_t status, uint8_t byte) {
+      data1 = byte;
+      return uint8_t(status | (ev.data.control.channel & 0x0F));
+    };
+
+    switch (ev.type)
+    {
+      case SND_SEQ_EVENT_NOTE:
+      case SND_SEQ_EVENT_NOTEON:
+        return note(0x90);
+      case SND_SEQ_EVENT_NOTEOFF:
+        return note(0x80);
+      case SND_SEQ_EVENT_KEYPRESS:
+        return note(0xA0);
+      case SND_SEQ_EVENT_CONTROLLER:
+      case SND_SEQ_EVENT_CONTROL14:
+        return control(0xB0, uint8_t(ev.data.control.param));
+      case SND_SEQ_EVENT_NONREGPARAM:
+        return control(0xB0, 99); // NRPN MSB
+      case SND_SEQ_EVENT_REGPARAM:
+        return control(0xB0, 101); // RPN MSB
+      case SND_SEQ_EVENT_PGMCHANGE:
+        return control(0xC0, uint8_t(ev.data.control.value));
+      case SND_SEQ_EVENT_CHANPRESS:
+        return control(0xD0, uint8_t(ev.data.control.value));
+      case SND_SEQ_EVENT_PITCHBEND:
+        return control(0xE0, 0);
+      case SND_SEQ_EVENT_SYSEX:
+        return 0xF0;
+      case SND_SEQ_EVENT_QFRAME:
+        return 0xF1;
+      case SND_SEQ_EVENT_SONGPOS:
+        return 0xF2;
+      case SND_SEQ_EVENT_SONGSEL:
+        return 0xF3;
+      case SND_SEQ_EVENT_TUNE_REQUEST:
+        return 0xF6;
+      case SND_SEQ_EVENT_CLOCK:
+        return 0xF8;
+      case SND_SEQ_EVENT_TICK:
+        return 0xF9;
+      case SND_SEQ_EVENT_START:
+        return 0xFA;
+      case SND_SEQ_EVENT_CONTINUE:
+        return 0xFB;
+      case SND_SEQ_EVENT_STOP:
+        return 0xFC;
+      case SND_SEQ_EVENT_SENSING:
+        return 0xFE;
+      case SND_SEQ_EVENT_RESET:
+        return 0xFF;
+      default:
+        return 0;
+    }
+  }
+
+  //! Starts the input queue, and notes its time zero to measure the delay
+  //! of the events.
+  void start_queue()
+  {
+#ifndef AVOID_TIMESTAMPING
+    snd_seq_start_queue(data.seq, data.queue_id, nullptr);
+    snd_seq_drain_output(data.seq);
+
+    if constexpr (port_counters::enabled)
+    {
+      snd_seq_queue_status_t* status;
+      snd_seq_queue_status_alloca(&status);
+      snd_seq_get_queue_status(data.seq, data.queue_id, status);
+      const snd_seq_real_time_t* rt = snd_seq_queue_status_get_real_time(status);
+      data.queueOrigin
+          = port_counters::now() - (int64_t(rt->tv_sec) * 1000000000 + rt->tv_nsec);
+    }
+#endif
+  }
+
+  // Flags of the sysex being reassembled
+  static constexpr uint8_t deliver_sysex = 1;
+  static constexpr uint8_t forward_sysex = 2;
+
+  //! Computes the delta time of a message from the time of its event,
+  //! and passes it to the callback or the queue.
+  static void deliver(
+      midi_in_api::in_data& data, alsa_data& apidata, rtmidi::message& message,
+      const snd_seq_real_time_t& x)
+  {
+    message.timestamp = 0.0;
+
+    // Method 1: Use the system time.
+    // gettimeofday(&tv, (struct timezone *)nullptr);
+    // time = (tv.tv_sec * 1000000) + tv.tv_usec;
+
+    // Method 2: Use the ALSA sequencer event time data.
+    // (thanks to Pedro Lopez-Cabanillas!).
+
+    // Using method from:
+    // https://www.gnu.org/software/libc/manual/html_node/Elapsed-Time.html
+
+    // Perform the carry for the later subtraction by updating y.
+    snd_seq_real_time_t& y(apidata.lastTime);
+    if (x.tv_nsec < y.tv_nsec)
+    {
+      int nsec = (y.tv_nsec - x.tv_nsec) / 1000000000 + 1;
+      y.tv_nsec -= 1000000000 * nsec;
+      y.tv_sec += nsec;
+    }
+    if (x.tv_nsec - y.tv_nsec > 1000000000)
+    {
+      int nsec = (x.tv_nsec - y.tv_nsec) / 1000000000;
+      y.tv_nsec += 1000000000 * nsec;
+      y.tv_sec -= nsec;
+    }
+
+    // Compute the time difference.
+    const double time = x.tv_sec - y.tv_sec + (x.tv_nsec - y.tv_nsec) * 1e-9;
+
+    apidata.lastTime = x;
+
+    if (data.firstMessage == true)
+      data.firstMessage = false;
+    else
+      message.timestamp = time;
+
+#ifndef AVOID_TIMESTAMPING
+    data.deliver(message, apidata.queueOrigin + int64_t(x.tv_sec) * 1000000000 + x.tv_nsec);
+#else
+    data.deliver(message);
+#endif
+  }
+
   static void* alsaMidiHandler(void* ptr)
   {
     auto& data = *static_cast<midi_in_api::in_data*>(ptr);
     auto& apidata = *static_cast<alsa_data*>(data.apiData);
 
-    double time{};
-    bool continueSysex = false;
-    bool doDecode = false;
     message message{};
     int poll_fd_count{};
     pollfd* poll_fds{};
@@ -645,22 +778,63 @@ private:
       result = snd_seq_event_input(apidata.seq, &ev);
       if (result == -ENOSPC)
       {
+        data.stats.dropped();
         std::cerr << "\nMidiInAlsa::alsaMidiHandler: MIDI input buffer overrun!\n\n";
         continue;
       }
       else if (result <= 0)
       {
+        data.stats.error();
         std::cerr << "\nMidiInAlsa::alsaMidiHandler: unknown MIDI input error!\n";
         perror("System reports");
         continue;
       }
 
+      RTMIDI17_TRACE_SCOPE("alsa::input_event");
+      const snd_seq_real_time_t when = ev->time.time;
+      const int64_t usec = when.tv_sec * int64_t(1000000) + when.tv_nsec / 1000;
+
+      // The parts of a sysex are not decoded but copied as they are, and
+      // reassembled separately for each sender.
+      if (ev->type == SND_SEQ_EVENT_SYSEX)
+      {
+        RTMIDI17_TRACE_SCOPE("alsa::sysex");
+        const auto bytes = static_cast<const unsigned char*>(ev->data.ext.ptr);
+        const auto size = std::size_t(ev->data.ext.len);
+        const uint32_t source = (uint32_t(ev->source.client) << 8) | ev->source.port;
+        uint8_t flags = 0;
+        if (size > 0 && bytes[0] == 0xF0)
+          flags = (data.filter.accept(0xF0, 0, usec) ? deliver_sysex : 0)
+                  | (data.thru.active() ? forward_sysex : 0);
+
+        data.sysex.feed(source, bytes, size, usec, flags, [&](rtmidi::message& m, uint8_t f) {
+          if (f & forward_sysex)
+            data.thru.forward(m.bytes.data(), m.bytes.size(), usec);
+          if (f & deliver_sysex)
+            deliver(data, apidata, m, when);
+        });
+        snd_seq_free_event(ev);
+        continue;
+      }
+
+      // Filter the event before decoding it, unless it may be forwarded
+      // by thru.
+      bool wanted = true;
+      uint8_t data1{};
+      const uint8_t status = event_status(*ev, data1);
+      if (status != 0)
+      {
+        wanted = data.filter.accept(status, data1, usec);
+        if (!wanted && !data.thru.active())
+        {
+          snd_seq_free_event(ev);
+          continue;
+        }
+      }
+
       // This is a bit weird, but we now have to decode an ALSA MIDI
       // event (back) into MIDI bytes.  We'll ignore non-MIDI types.
-      if (!continueSysex)
-        message.bytes.clear();
-
-      doDecode = false;
+      message.bytes.clear();
       switch (ev->type)
       {
 
@@ -680,105 +854,19 @@ private:
 #endif
           break;
 
-        case SND_SEQ_EVENT_QFRAME: // MIDI time code
-          if (!(data.ignoreFlags & 0x02))
-            doDecode = true;
-          break;
-
-        case SND_SEQ_EVENT_TICK: // 0xF9 ... MIDI timing tick
-          if (!(data.ignoreFlags & 0x02))
-            doDecode = true;
-          break;
-
-        case SND_SEQ_EVENT_CLOCK: // 0xF8 ... MIDI timing (clock) tick
-          if (!(data.ignoreFlags & 0x02))
-            doDecode = true;
-          break;
-
-        case SND_SEQ_EVENT_SENSING: // Active sensing
-          if (!(data.ignoreFlags & 0x04))
-            doDecode = true;
-          break;
-
-        case SND_SEQ_EVENT_SYSEX:
-        {
-          if ((data.ignoreFlags & 0x01))
-            break;
-          if (ev->data.ext.len > apidata.bufferSize)
-          {
-            apidata.bufferSize = ev->data.ext.len;
-            buffer.resize(apidata.bufferSize);
-          }
-          doDecode = true;
-          break;
-        }
-
         default:
-          doDecode = true;
-      }
-
-      if (doDecode)
-      {
-        uint64_t nBytes
-            = snd_midi_event_decode(apidata.coder, buffer.data(), apidata.bufferSize, ev);
-        if (nBytes > 0)
         {
-          // The ALSA sequencer has a maximum buffer size for MIDI sysex
-          // events of 256 bytes.  If a device sends sysex messages larger
-          // than this, they are segmented into 256 byte chunks.  So,
-          // we'll watch for this and concatenate sysex chunks into a
-          // single sysex message if necessary.
-          assert(nBytes < buffer.size());
-          if (!continueSysex)
-            message.bytes.assign(buffer.data(), buffer.data() + nBytes);
-          else
-            message.bytes.insert(message.bytes.end(), buffer.data(), buffer.data() + nBytes);
-
-          continueSysex = ((ev->type == SND_SEQ_EVENT_SYSEX) && (message.bytes.back() != 0xF7));
-          if (!continueSysex)
+          RTMIDI17_TRACE_SCOPE("alsa::decode");
+          const long nBytes
+              = snd_midi_event_decode(apidata.coder, buffer.data(), apidata.bufferSize, ev);
+          if (nBytes > 0)
           {
-
-            // Calculate the time stamp:
-            message.timestamp = 0.0;
-
-            // Method 1: Use the system time.
-            // gettimeofday(&tv, (struct timezone *)nullptr);
-            // time = (tv.tv_sec * 1000000) + tv.tv_usec;
-
-            // Method 2: Use the ALSA sequencer event time data.
-            // (thanks to Pedro Lopez-Cabanillas!).
-
-            // Using method from:
-            // https://www.gnu.org/software/libc/manual/html_node/Elapsed-Time.html
-
-            // Perform the carry for the later subtraction by updating y.
-            snd_seq_real_time_t& x(ev->time.time);
-            snd_seq_real_time_t& y(apidata.lastTime);
-            if (x.tv_nsec < y.tv_nsec)
-            {
-              int nsec = (y.tv_nsec - x.tv_nsec) / 1000000000 + 1;
-              y.tv_nsec -= 1000000000 * nsec;
-              y.tv_sec += nsec;
-            }
-            if (x.tv_nsec - y.tv_nsec > 1000000000)
-            {
-              int nsec = (x.tv_nsec - y.tv_nsec) / 1000000000;
-              y.tv_nsec += 1000000000 * nsec;
-              y.tv_sec -= nsec;
-            }
-
-            // Compute the time difference.
-            time = x.tv_sec - y.tv_sec + (x.tv_nsec - y.tv_nsec) * 1e-9;
-
-            apidata.lastTime = ev->time.time;
-
-            if (data.firstMessage == true)
-              data.firstMessage = false;
-            else
-              message.timestamp = time;
+            message.bytes.assign(buffer.data(), buffer.data() + nBytes);
           }
           else
           {
+            if (status != 0)
+              data.stats.error();
 #if defined(__RTMIDI17_DEBUG__)
             std::cerr << "\nMidiInAlsa::alsaMidiHandler: event parsing error or "
                          "not a MIDI event!\n\n";
@@ -788,20 +876,12 @@ private:
       }
 
       snd_seq_free_event(ev);
-      if (message.bytes.size() == 0 || continueSysex)
+      if (message.bytes.size() == 0)
         continue;
 
-      if (data.userCallback)
-      {
-        data.userCallback(std::move(message));
-      }
-      else
-      {
-        // As long as we haven't reached our queue size limit, push the
-        // message.
-        if (!data.queue.push(std::move(message)))
-          std::cerr << "\nMidiInAlsa: message queue limit reached!!\n\n";
-      }
+      data.thru.forward(message.bytes.data(), message.bytes.size(), usec);
+      if (wanted)
+        deliver(data, apidata, message, when);
     }
 
     snd_midi_event_free(apidata.coder);
@@ -809,7 +889,14 @@ private:
     apidata.thread = apidata.dummy_thread_id;
     return nullptr;
   }
+
+  bool connect_thru(midi_out_api& out) override;
+  void disconnect_thru(midi_out_api& out) override;
+
   alsa_data data;
+
+  // Subscriptions from the source of this input to thru outputs
+  std::vector<std::pair<midi_out_api*, snd_seq_port_subscribe_t*>> nativeThru_;
 };
 
 class midi_out_alsa final : public midi_out_api
@@ -834,6 +921,7 @@ public:
     // Save our api-specific connection information.
     data.seq = seq;
     data.vport = -1;
+    data.queue_id = -1;
     data.bufferSize = 32;
     data.coder = nullptr;
     int result = snd_midi_event_new(data.bufferSize, &data.coder);
@@ -853,6 +941,8 @@ public:
     midi_out_alsa::close_port();
 
     // Cleanup.
+    if (data.queue_id >= 0)
+      snd_seq_free_queue(data.seq, data.queue_id);
     if (data.vport >= 0)
       snd_seq_delete_port(data.seq, data.vport);
     if (data.coder)
@@ -947,6 +1037,13 @@ public:
     }
   }
 
+  //! The port this output is connected to, if it was opened with open_port()
+  const snd_seq_addr_t* destination() const noexcept
+  {
+    return connected_ && data.subscription ? snd_seq_port_subscribe_get_dest(data.subscription)
+                                           : nullptr;
+  }
+
   void close_port() override
   {
     if (connected_)
@@ -1012,6 +1109,39 @@ public:
   }
 
   void send_message(const unsigned char* message, size_t size) override
+  {
+    snd_seq_event_t ev;
+    if (encode(message, size, ev))
+      output(ev);
+  }
+
+  //! Messages are scheduled on an ALSA queue, which delivers them at
+  //! their timestamp from the kernel.
+  void schedule_message(int64_t timestamp, const unsigned char* message, size_t size) override
+  {
+    snd_seq_event_t ev;
+    if (!encode(message, size, ev))
+      return;
+
+    // Messages which are already due are sent directly.
+    if (timestamp > get_current_time() && start_queue())
+    {
+      const int64_t t = timestamp - queueOrigin_;
+      snd_seq_real_time_t rt;
+      rt.tv_sec = static_cast<unsigned int>(t / 1000000);
+      rt.tv_nsec = static_cast<unsigned int>((t % 1000000) * 1000);
+      snd_seq_ev_schedule_real(&ev, data.queue_id, 0, &rt);
+    }
+    output(ev);
+  }
+
+  bool has_native_scheduling() const noexcept override
+  {
+    return true;
+  }
+
+private:
+  bool encode(const unsigned char* message, size_t size, snd_seq_event_t& ev)
   {
     int64_t result{};
     unsigned int nBytes = static_cast<unsigned int>(size);
@@ -1024,11 +1154,10 @@ public:
         error<driver_error>(
             "MidiOutAlsa::sendMessage: ALSA error resizing MIDI event "
             "buffer.");
-        return;
+        return false;
       }
     }
 
-    snd_seq_event_t ev;
     snd_seq_ev_clear(&ev);
     snd_seq_ev_set_source(&ev, data.vport);
     snd_seq_ev_set_subs(&ev);
@@ -1037,24 +1166,88 @@ public:
     result = snd_midi_event_encode(data.coder, message, nBytes, &ev);
     if (result < nBytes)
     {
+      stats_.error();
       warning("MidiOutAlsa::sendMessage: event parsing error!");
-      return;
+      return false;
     }
+    return true;
+  }
 
+  void output(snd_seq_event_t& ev)
+  {
     // Send the event.
-    result = snd_seq_event_output(data.seq, &ev);
-    if (result < 0)
+    if (snd_seq_event_output(data.seq, &ev) < 0)
     {
+      stats_.error();
       warning("MidiOutAlsa::sendMessage: error sending MIDI message to port.");
       return;
     }
     snd_seq_drain_output(data.seq);
   }
 
-private:
+  // The output queue is only allocated once scheduling is used, as the
+  // number of ALSA queues is limited system-wide.
+  bool start_queue()
+  {
+    if (data.queue_id >= 0)
+      return true;
+
+    data.queue_id = snd_seq_alloc_named_queue(data.seq, "RtMidi Output Queue");
+    if (data.queue_id < 0)
+    {
+      warning("MidiOutAlsa::scheduleMessage: error allocating the output queue.");
+      return false;
+    }
+    snd_seq_start_queue(data.seq, data.queue_id, nullptr);
+    snd_seq_drain_output(data.seq);
+
+    // Time zero of the queue, on the clock of get_current_time()
+    snd_seq_queue_status_t* status;
+    snd_seq_queue_status_alloca(&status);
+    snd_seq_get_queue_status(data.seq, data.queue_id, status);
+    const snd_seq_real_time_t* rt = snd_seq_queue_status_get_real_time(status);
+    queueOrigin_ = get_current_time() - (int64_t(rt->tv_sec) * 1000000 + rt->tv_nsec / 1000);
+    return true;
+  }
+
+  int64_t queueOrigin_{};
   alsa_data data;
 };
 
+inline bool midi_in_alsa::connect_thru(midi_out_api& out)
+{
+  auto alsa_out = dynamic_cast<midi_out_alsa*>(&out);
+  if (!alsa_out || !data.subscription || !alsa_out->destination())
+    return false;
+
+  snd_seq_port_subscribe_t* sub{};
+  if (snd_seq_port_subscribe_malloc(&sub) < 0)
+    return false;
+  snd_seq_port_subscribe_set_sender(sub, snd_seq_port_subscribe_get_sender(data.subscription));
+  snd_seq_port_subscribe_set_dest(sub, alsa_out->destination());
+  if (snd_seq_subscribe_port(data.seq, sub) < 0)
+  {
+    // For instance if the two ports are already connected
+    snd_seq_port_subscribe_free(sub);
+    return false;
+  }
+
+  nativeThru_.emplace_back(&out, sub);
+  return true;
+}
+
+inline void midi_in_alsa::disconnect_thru(midi_out_api& out)
+{
+  auto it = std::find_if(
+      nativeThru_.begin(), nativeThru_.end(), [&](const auto& p) { return p.first == &out; });
+  if (it == nativeThru_.end())
+    return;
+
+  snd_seq_unsubscribe_port(data.seq, it->second);
+  snd_seq_port_subscribe_free(it->second);
+  nativeThru_.erase(it);
+}
+
 struct alsa_backend
 {
   using midi_in = midi_in_alsa;
@@ -0,0 +1,108 @@
+#pragma once
+#include <rtmidi17/detail/seqlock.hpp>
+#include <rtmidi17/input_filter.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+namespace rtmidi
+{
+//! An input_filter reduced to lookup tables, evaluated by the thread
+//! which receives the messages of an input, before they are decoded or
+//! copied. It can be changed from any other thread: the receiving thread
+//! only reloads its copy when it changed. set() has a single writer at a
+//! time, which midi_in_api ensures with a mutex.
+class compiled_filter
+{
+public:
+  compiled_filter()
+  {
+    std::fill_n(last_, input_filter::type_count, INT64_MIN / 2);
+    set(input_filter{});
+  }
+
+  void set(const input_filter& f) noexcept
+  {
+    table t{};
+    for (int status = 0x80; status <= 0xFF; status++)
+    {
+      const int type = input_filter::type_index(uint8_t(status));
+      bool accepted = f.types & (uint32_t(1) << type);
+      if (status < 0xF0)
+        accepted = accepted && (f.channels & (1 << (status & 0x0F)));
+      if (accepted)
+        t.accepted[(status - 0x80) >> 6] |= uint64_t(1) << (status & 63);
+    }
+    t.notes[0] = f.lowest_note;
+    t.notes[1] = f.highest_note;
+    t.controls[0] = f.lowest_control;
+    t.controls[1] = f.highest_control;
+    for (int type = 0; type < input_filter::type_count; type++)
+    {
+      if (f.max_rate[type] > 0.f)
+      {
+        t.interval[type] = int64_t(1e6 / f.max_rate[type]);
+        t.limited |= uint32_t(1) << type;
+      }
+    }
+
+    table_.store(t);
+    generation_.fetch_add(1, std::memory_order_release);
+  }
+
+  //! Called by the receiving thread for each message, or each part of a
+  //! segmented sysex, with the first two bytes of the message and its
+  //! time in microseconds.
+  bool accept(uint8_t status, uint8_t data1, int64_t time) noexcept
+  {
+    if (const auto g = generation_.load(std::memory_order_acquire); g != loaded_)
+    {
+      loaded_ = g;
+      current_ = table_.load();
+    }
+
+    // The continuation of a sysex follows the decision for its start.
+    if (status < 0x80)
+      return sysex_;
+
+    bool ok = current_.accepted[(status - 0x80) >> 6] & (uint64_t(1) << (status & 63));
+    if (ok && status < 0xC0)
+    {
+      const uint8_t* range = status >= 0xB0 ? current_.controls : current_.notes;
+      ok = data1 >= range[0] && data1 <= range[1];
+    }
+
+    const int type = input_filter::type_index(status);
+    if (ok && (current_.limited & (uint32_t(1) << type)))
+    {
+      ok = time - last_[type] >= current_.interval[type];
+      if (ok)
+        last_[type] = time;
+    }
+
+    if (status == 0xF0)
+      sysex_ = ok;
+    return ok;
+  }
+
+private:
+  struct table
+  {
+    uint64_t accepted[2]; // one bit per status byte from 0x80
+    uint8_t notes[2];
+    uint8_t controls[2];
+    uint32_t limited; // one bit per rate-limited type
+    int64_t interval[input_filter::type_count];
+  };
+
+  seqlock<table> table_;
+  std::atomic<uint32_t> generation_{};
+
+  // Only accessed by the receiving thread
+  uint32_t loaded_{};
+  table current_{};
+  int64_t last_[input_filter::type_count]; // time of the last accepted message
+  bool sysex_{};
+};
+}
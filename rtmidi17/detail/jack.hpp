@@ -12,6 +12,14 @@
 #  include <rtmidi17/detail/semaphore.hpp>
 #  include <rtmidi17/rtmidi17.hpp>
 
+#  include <atomic>
+#  include <cstring>
+#  include <map>
+#  include <mutex>
+#  include <optional>
+#  include <sstream>
+#  include <thread>
+
 //*********************************************************************//
 //  API: UNIX JACK
 //
@@ -25,30 +33,481 @@ namespace rtmidi
 struct jack_data
 {
   static const constexpr auto ringbuffer_size = 16384;
+
+  //! Each message in the ringbuffers is framed by this header.
+  //! On output, a time of zero means "as soon as possible".
+  //! On input, frame is the absolute frame at which the event was received,
+  //! and deliver is false for the messages only kept for thru.
+  struct message_header
+  {
+    jack_time_t time{};
+    jack_nframes_t frame{};
+    uint32_t size{};
+    bool deliver{true};
+  };
+
   jack_client_t* client{};
   jack_port_t* port{};
-  jack_ringbuffer_t* buffSize{};
-  jack_ringbuffer_t* buffMessage{};
+  jack_ringbuffer_t* ringbuffer{};
+  //! On output, the messages with a time. They are kept apart from those
+  //! sent as soon as possible, which they would otherwise hold back until
+  //! their time.
+  jack_ringbuffer_t* scheduled{};
+  //! On output, the messages forwarded by the thru routes of the inputs of
+  //! the same client, whose process thread is the only writer.
+  jack_ringbuffer_t* thru{};
   jack_time_t lastTime{};
 
+  //! Messages dropped because the ringbuffer was full
+  std::atomic<uint64_t> overflows{};
+  //! Messages dropped because they did not fit in an empty JACK buffer
+  std::atomic<uint64_t> oversized{};
+
   rtmidi::semaphore sem_cleanup;
   rtmidi::semaphore sem_needpost{};
+  rtmidi::rt_semaphore sem_input{};
 
   midi_in_api::in_data* rtMidiIn{};
 };
 
+//! Copies framed records in the free space of a ringbuffer, and makes
+//! them visible to the reader all at once on commit().
+//! The caller must have checked that there is enough space.
+struct jack_record_writer
+{
+  explicit jack_record_writer(jack_ringbuffer_t* rb) : ringbuffer{rb}
+  {
+    jack_ringbuffer_get_write_vector(ringbuffer, vec);
+  }
+
+  void write(const jack_data::message_header& header, const unsigned char* message)
+  {
+    copy(&header, sizeof(header));
+    copy(message, header.size);
+  }
+
+  void commit()
+  {
+    jack_ringbuffer_write_advance(ringbuffer, written);
+  }
+
+private:
+  void copy(const void* src, size_t size)
+  {
+    auto bytes = static_cast<const char*>(src);
+    const auto first = std::min(size, vec[0].len > written ? vec[0].len - written : 0);
+    if (first > 0)
+      std::memcpy(vec[0].buf + written, bytes, first);
+    if (size > first)
+      std::memcpy(vec[1].buf + (written + first - vec[0].len), bytes + first, size - first);
+    written += size;
+  }
+
+  jack_ringbuffer_t* ringbuffer{};
+  jack_ringbuffer_data_t vec[2]{};
+  size_t written{};
+};
+
+//! Forwards port registrations, unregistrations and renamings to
+//! self->on_port_registration / on_port_rename.
+//! They are invoked by JACK in its notification thread.
+template <typename T>
+void jack_set_port_callbacks(jack_client_t* client, T* self)
+{
+  jack_set_port_registration_callback(
+      client,
+      [](jack_port_id_t port, int reg, void* arg) {
+        static_cast<T*>(arg)->on_port_registration(port, reg != 0);
+      },
+      self);
+
+#  if defined(RTMIDI17_JACK_HAS_PORT_RENAME)
+  // The callback returns int with JACK1 and void with JACK2.
+  using rename_return_t
+      = decltype(std::declval<JackPortRenameCallback>()(0, nullptr, nullptr, nullptr));
+  jack_set_port_rename_callback(
+      client,
+      [](jack_port_id_t port, const char* old_name, const char* new_name,
+         void* arg) -> rename_return_t {
+        static_cast<T*>(arg)->on_port_rename(port, old_name, new_name);
+        return rename_return_t();
+      },
+      self);
+#  endif
+}
+
+//! List of the MIDI ports with the given flags, which is refreshed
+//! only after JACK notified that the port graph changed.
+struct jack_port_cache
+{
+  explicit jack_port_cache(unsigned long f) : flags{f}
+  {
+  }
+
+  void invalidate() noexcept
+  {
+    dirty = true;
+  }
+
+  unsigned int count(jack_client_t* client)
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    refresh(client);
+    return names.size();
+  }
+
+  std::optional<std::string> name(jack_client_t* client, unsigned int i)
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    refresh(client);
+    if (i >= names.size())
+      return std::nullopt;
+    return names[i];
+  }
+
+private:
+  void refresh(jack_client_t* client)
+  {
+    if (dirty.exchange(false))
+    {
+      names.clear();
+      if (auto ports = jack_get_ports(client, nullptr, JACK_DEFAULT_MIDI_TYPE, flags))
+      {
+        for (int i = 0; ports[i] != nullptr; i++)
+          names.emplace_back(ports[i]);
+        jack_free(ports);
+      }
+    }
+  }
+
+  const unsigned long flags{};
+  std::atomic_bool dirty{true};
+  std::mutex mutex;
+  std::vector<std::string> names;
+};
+
+//! Owns a JACK client and runs the process callbacks of the MIDI ports it
+//! hosts. When RTMIDI17_JACK_SHARED_CLIENT is defined, all the midi_in and
+//! midi_out created with the same client name share a single JACK client,
+//! so that the cost of a process cycle stays nearly constant as ports are
+//! added. Port names must then be unique for a given client name.
+class jack_client_host
+{
+public:
+  static std::shared_ptr<jack_client_host> acquire(const std::string& name)
+  {
+#  if defined(RTMIDI17_JACK_SHARED_CLIENT)
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<jack_client_host>> hosts;
+
+    std::lock_guard<std::mutex> lock{mutex};
+    for (auto it = hosts.begin(); it != hosts.end();)
+    {
+      if (it->second.expired())
+        it = hosts.erase(it);
+      else
+        ++it;
+    }
+
+    auto& host = hosts[name];
+    if (auto ptr = host.lock())
+      return ptr;
+
+    auto ptr = create(name);
+    host = ptr;
+    return ptr;
+#  else
+    return create(name);
+#  endif
+  }
+
+  explicit jack_client_host(jack_client_t* client)
+      : client_{client}, ports_{new std::vector<hosted_port>}
+  {
+    jack_set_process_callback(client_, process, this);
+    jack_set_port_callbacks(client_, this);
+    jack_activate(client_);
+  }
+
+  ~jack_client_host()
+  {
+    jack_deactivate(client_);
+    jack_client_close(client_);
+    delete ports_.load();
+  }
+
+  jack_client_host(const jack_client_host&) = delete;
+  jack_client_host(jack_client_host&&) = delete;
+  jack_client_host& operator=(const jack_client_host&) = delete;
+  jack_client_host& operator=(jack_client_host&&) = delete;
+
+  jack_client_t* client() const noexcept
+  {
+    return client_;
+  }
+
+  //! Starts calling process(nframes, arg) in each cycle.
+  void add(JackProcessCallback process, void* arg)
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto ports = std::make_unique<std::vector<hosted_port>>(*ports_.load());
+    ports->push_back({process, arg});
+    publish(std::move(ports));
+  }
+
+  //! Once this returns, the process callback for arg is not running
+  //! anymore and will not be called again.
+  void remove(void* arg)
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto ports = std::make_unique<std::vector<hosted_port>>(*ports_.load());
+    ports->erase(
+        std::remove_if(
+            ports->begin(), ports->end(), [=](const hosted_port& p) { return p.arg == arg; }),
+        ports->end());
+    publish(std::move(ports));
+  }
+
+  void on_port_registration(jack_port_id_t, bool) noexcept
+  {
+    sources.invalidate();
+    destinations.invalidate();
+  }
+
+  void on_port_rename(jack_port_id_t, const char*, const char*) noexcept
+  {
+    sources.invalidate();
+    destinations.invalidate();
+  }
+
+  //! Ports which midi_in can connect to
+  jack_port_cache sources{JackPortIsOutput};
+  //! Ports which midi_out can connect to
+  jack_port_cache destinations{JackPortIsInput};
+
+private:
+  struct hosted_port
+  {
+    JackProcessCallback process{};
+    void* arg{};
+  };
+
+  static std::shared_ptr<jack_client_host> create(const std::string& name)
+  {
+    auto client = jack_client_open(name.c_str(), JackNoStartServer, nullptr);
+    if (!client)
+      return {};
+    return std::make_shared<jack_client_host>(client);
+  }
+
+  // The list of ports is never modified in place: a new one is swapped in,
+  // and the old one is freed once the process callback is done with it.
+  void publish(std::unique_ptr<std::vector<hosted_port>> ports)
+  {
+    using namespace std::literals;
+    std::unique_ptr<std::vector<hosted_port>> old{ports_.exchange(ports.release())};
+    while (processing_)
+      std::this_thread::sleep_for(100us);
+  }
+
+  static int process(jack_nframes_t nframes, void* arg)
+  {
+    auto& self = *static_cast<jack_client_host*>(arg);
+    self.processing_ = true;
+    for (const auto& port : *self.ports_.load())
+      port.process(nframes, port.arg);
+    self.processing_ = false;
+    return 0;
+  }
+
+  jack_client_t* client_{};
+  std::mutex mutex_;
+  std::atomic<std::vector<hosted_port>*> ports_{};
+  std::atomic_bool processing_{false};
+};
+
 class observer_jack final : public observer_api
 {
 public:
   observer_jack(observer::callbacks&& c) : observer_api{std::move(c)}
   {
+    client_ = jack_client_open("rtmidi17-observe", JackNoStartServer, nullptr);
+    if (client_ == nullptr)
+    {
+      throw driver_error("observer_jack: JACK server not running?");
+    }
+
+    running_ = true;
+    thread_ = std::thread{[this] {
+      while (this->running_)
+      {
+        sem_.wait();
+        process_events();
+      }
+    }};
+
+    jack_set_port_callbacks(client_, this);
+    jack_activate(client_);
   }
 
   ~observer_jack()
   {
+    jack_deactivate(client_);
+    jack_client_close(client_);
+
+    running_ = false;
+    sem_.notify();
+    thread_.join();
+  }
+
+  // Called from the JACK notification thread: the port is looked up
+  // immediately, as it may be gone later, and the user callbacks are
+  // deferred to our own thread.
+  void on_port_registration(jack_port_id_t id, bool reg)
+  {
+    event e{id, reg ? event::registered : event::unregistered, {}, {}};
+    if (auto port = jack_port_by_id(client_, id))
+      e.info = get_info(port);
+    push_event(std::move(e));
+  }
+
+  void on_port_rename(jack_port_id_t id, const char* old_name, const char* new_name)
+  {
+    event e{id, event::renamed, {}, old_name};
+    if (auto port = jack_port_by_id(client_, id))
+      e.info = get_info(port);
+    e.info.name = new_name;
+    push_event(std::move(e));
+  }
+
+private:
+  struct port_info
+  {
+    std::string name;
+    bool isMidi{};
+    bool isInput{};
+    bool isOutput{};
+  };
+
+  struct event
+  {
+    jack_port_id_t id{};
+    enum
+    {
+      registered,
+      unregistered,
+      renamed
+    } type{};
+    port_info info;
+    std::string old_name;
+  };
+
+  // Only MIDI ports of other clients are of interest.
+  port_info get_info(jack_port_t* port) const
+  {
+    port_info p;
+    if (jack_port_is_mine(client_, port))
+      return p;
+
+    const int flags = jack_port_flags(port);
+    p.name = jack_port_name(port);
+    p.isMidi = std::string_view{jack_port_type(port)} == JACK_DEFAULT_MIDI_TYPE;
+    p.isInput = flags & JackPortIsOutput;
+    p.isOutput = flags & JackPortIsInput;
+    return p;
+  }
+
+  void push_event(event e)
+  {
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      events_.push_back(std::move(e));
+    }
+    sem_.notify();
+  }
+
+  void process_events()
+  {
+    std::vector<event> events;
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      events.swap(events_);
+    }
+
+    for (auto& e : events)
+    {
+      switch (e.type)
+      {
+        case event::registered:
+        {
+          if (e.info.isMidi)
+          {
+            knownPorts_[e.id] = e.info;
+            notify_added(e.id, e.info);
+          }
+          break;
+        }
+        case event::unregistered:
+        {
+          auto it = knownPorts_.find(e.id);
+          if (it != knownPorts_.end())
+          {
+            e.info = std::move(it->second);
+            knownPorts_.erase(it);
+          }
+
+          if (e.info.isMidi)
+            notify_removed(e.id, e.info);
+          break;
+        }
+        case event::renamed:
+        {
+          auto it = knownPorts_.find(e.id);
+          if (it != knownPorts_.end())
+          {
+            notify_removed(e.id, it->second);
+            it->second.name = e.info.name;
+            notify_added(e.id, it->second);
+          }
+          else if (e.info.isMidi)
+          {
+            knownPorts_[e.id] = e.info;
+            notify_added(e.id, e.info);
+          }
+          break;
+        }
+      }
+    }
+  }
+
+  void notify_added(jack_port_id_t id, const port_info& p)
+  {
+    if (p.isInput && callbacks_.input_added)
+      callbacks_.input_added(id, p.name);
+    if (p.isOutput && callbacks_.output_added)
+      callbacks_.output_added(id, p.name);
   }
+
+  void notify_removed(jack_port_id_t id, const port_info& p)
+  {
+    if (p.isInput && callbacks_.input_removed)
+      callbacks_.input_removed(id, p.name);
+    if (p.isOutput && callbacks_.output_removed)
+      callbacks_.output_removed(id, p.name);
+  }
+
+  jack_client_t* client_{};
+  std::atomic_bool running_{false};
+  std::thread thread_;
+  rtmidi::semaphore sem_;
+  std::mutex mutex_;
+  std::vector<event> events_;
+  std::map<jack_port_id_t, port_info> knownPorts_;
 };
 
+//! Queues a message to a JACK output from the process thread of its client.
+inline void jack_send_thru(midi_out_api& out, const unsigned char* message, size_t size) noexcept;
+
 class midi_in_jack final : public midi_in_api
 {
 public:
@@ -61,6 +520,15 @@ public:
     data.client = nullptr;
     this->clientName = cname;
 
+    // The process callback only copies the raw events in this ringbuffer;
+    // they are turned into messages by the input thread.
+    data.ringbuffer = jack_ringbuffer_create(jack_data::ringbuffer_size);
+    jack_ringbuffer_mlock(data.ringbuffer);
+    buffer.resize(jack_data::ringbuffer_size);
+
+    running = true;
+    thread = std::thread{[this] { this->input_thread(); }};
+
     connect();
   }
 
@@ -68,8 +536,15 @@ public:
   {
     midi_in_jack::close_port();
 
-    if (data.client)
-      jack_client_close(data.client);
+    if (host)
+      host->remove(&data);
+    host.reset();
+
+    running = false;
+    data.sem_input.notify();
+    thread.join();
+
+    jack_ringbuffer_free(data.ringbuffer);
   }
 
   rtmidi::API get_current_api() const noexcept override
@@ -140,171 +615,201 @@ public:
 
   unsigned int get_port_count() override
   {
-    int count = 0;
     connect();
-    if (!data.client)
-      return 0;
-
-    // List of available ports
-    auto ports = jack_get_ports(data.client, nullptr, JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput);
-
-    if (!ports)
+    if (!host)
       return 0;
 
-    while (ports[count] != nullptr)
-      count++;
-
-    jack_free(ports);
-
-    return count;
+    return host->sources.count(data.client);
   }
 
   std::string get_port_name(unsigned int portNumber) override
   {
-    std::string retStr;
-
     connect();
-
-    // List of available ports
-    auto ports = jack_get_ports(data.client, nullptr, JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput);
+    if (!host)
+      return {};
 
     // Check port validity
-    if (ports == nullptr)
+    if (host->sources.count(data.client) == 0)
     {
       warning("MidiInJack::getPortName: no ports available!");
-      return retStr;
+      return {};
     }
 
-    if (ports[portNumber] == nullptr)
+    auto name = host->sources.name(data.client, portNumber);
+    if (!name)
     {
       std::ostringstream ost;
       ost << "MidiInJack::getPortName: the 'portNumber' argument (" << portNumber
           << ") is invalid.";
       warning(ost.str());
+      return {};
     }
-    else
-      retStr.assign(ports[portNumber]);
 
-    jack_free(ports);
-    return retStr;
+    return *name;
   }
 
 private:
   void connect()
   {
-    if (data.client)
+    if (host)
       return;
 
     // Initialize JACK client
-    data.client = jack_client_open(clientName.c_str(), JackNoStartServer, nullptr);
-    if (data.client == nullptr)
+    host = jack_client_host::acquire(clientName);
+    if (!host)
     {
       warning("MidiInJack::initialize: JACK server not running?");
       return;
     }
 
-    jack_set_process_callback(data.client, jackProcessIn, &data);
-    jack_activate(data.client);
+    // From the JACK clock to the one of the statistics, in nanoseconds
+    clockOffset = port_counters::now() - int64_t(jack_get_time()) * 1000;
+
+    data.client = host->client();
+    host->add(jackProcessIn, &data);
   }
 
   static int jackProcessIn(jack_nframes_t nframes, void* arg)
   {
-    jack_data& jData = *(jack_data*)arg;
-    midi_in_api::in_data& rtData = *jData.rtMidiIn;
-    jack_midi_event_t event;
-    jack_time_t time;
+    auto& data = *(jack_data*)arg;
 
     // Is port created?
-    if (jData.port == nullptr)
+    if (data.port == nullptr)
       return 0;
-    void* buff = jack_port_get_buffer(jData.port, nframes);
 
-    // We have midi events in buffer
-    uint32_t evCount = jack_midi_get_event_count(buff);
+    RTMIDI17_TRACE_SCOPE("jack::process_in");
+    void* buff = jack_port_get_buffer(data.port, nframes);
+    const jack_nframes_t cycle_start = jack_last_frame_time(data.client);
+
+    // This runs in the realtime thread: just copy the events for the
+    // input thread, without any allocation nor lock.
+    jack_midi_event_t event;
+    const uint32_t evCount = jack_midi_get_event_count(buff);
     for (uint32_t j = 0; j < evCount; j++)
     {
-      message m;
-
       jack_midi_event_get(&event, buff, j);
-
-      m.bytes.assign(event.buffer, event.buffer + event.size);
-
-      // Compute the delta time.
-      time = jack_get_time();
-      if (rtData.firstMessage == true)
-      {
-        m.timestamp = 0.;
-        rtData.firstMessage = false;
-      }
-      else
+      if (event.size == 0)
+        continue;
+
+      // event.time is the offset of the event in the current cycle.
+      const jack_nframes_t frame = cycle_start + event.time;
+      const jack_time_t time = jack_frames_to_time(data.client, frame);
+
+      // The realtime thru routes queue the message to outputs of the same
+      // client: it is sent during this cycle if they are processed after
+      // this input. The input thread forwards it on the other routes.
+      auto& thru = data.rtMidiIn->thru;
+      thru.forward_realtime(event.buffer, event.size, int64_t(time), jack_send_thru);
+
+      // Filtered messages are not even copied, unless thru needs them.
+      const uint8_t data1 = event.size > 1 ? event.buffer[1] : 0;
+      const bool wanted = data.rtMidiIn->filter.accept(event.buffer[0], data1, int64_t(time));
+      if (!wanted && !thru.deferred())
+        continue;
+
+      if (jack_ringbuffer_write_space(data.ringbuffer)
+          < sizeof(jack_data::message_header) + event.size)
       {
-        m.timestamp = (time - jData.lastTime) * 0.000001;
+        data.overflows.fetch_add(1, std::memory_order_relaxed);
+        continue;
       }
 
-      jData.lastTime = time;
-      if (!rtData.continueSysex)
-        m.clear();
+      jack_record_writer w{data.ringbuffer};
+      w.write({time, frame, uint32_t(event.size), wanted}, event.buffer);
+      w.commit();
+    }
 
-      if (!((rtData.continueSysex || event.buffer[0] == 0xF0) && (rtData.ignoreFlags & 0x01)))
-      {
-        // Unless this is a (possibly continued) SysEx message and we're ignoring SysEx,
-        // copy the event buffer into the MIDI message struct.
-        for (unsigned int i = 0; i < event.size; i++)
-          m.bytes.push_back(event.buffer[i]);
-      }
+    if (evCount > 0)
+      data.sem_input.notify();
 
-      switch (event.buffer[0])
+    return 0;
+  }
+
+  void input_thread()
+  {
+    jack_data::message_header header;
+    uint64_t overflows = 0;
+
+    while (running)
+    {
+      data.sem_input.wait();
+
+      while (jack_ringbuffer_read_space(data.ringbuffer) >= sizeof(header))
       {
-        case 0xF0:
-          // Start of a SysEx message
-          rtData.continueSysex = event.buffer[event.size - 1] != 0xF7;
-          if (rtData.ignoreFlags & 0x01)
-            continue;
-          break;
-        case 0xF1:
-        case 0xF8:
-          // MIDI Time Code or Timing Clock message
-          if (rtData.ignoreFlags & 0x02)
-            continue;
-          break;
-        case 0xFE:
-          // Active Sensing message
-          if (rtData.ignoreFlags & 0x04)
-            continue;
-          break;
-        default:
-          if (rtData.continueSysex)
-          {
-            // Continuation of a SysEx message
-            rtData.continueSysex = event.buffer[event.size - 1] != 0xF7;
-            if (rtData.ignoreFlags & 0x01)
-              continue;
-          }
-          // All other MIDI messages
+        jack_ringbuffer_read(data.ringbuffer, (char*)&header, sizeof(header));
+        jack_ringbuffer_read(data.ringbuffer, (char*)buffer.data(), header.size);
+        handle_event(header, buffer.data());
       }
 
-      if (!rtData.continueSysex)
+      if (auto n = data.overflows.load(std::memory_order_relaxed); n != overflows)
       {
-        // If not a continuation of a SysEx message,
-        // invoke the user callback function or queue the message.
-        if (rtData.userCallback)
-        {
-          rtData.userCallback(std::move(m));
-        }
-        else
-        {
-          // As long as we haven't reached our queue size limit, push the
-          // message.
-          if (!rtData.queue.push(std::move(m)))
-            std::cerr << "\nMidiInJack: message queue limit reached!!\n\n";
-        }
+        overflows = n;
+        warning("MidiInJack: input ringbuffer overflow, messages were dropped.");
       }
     }
+  }
 
-    return 0;
+  void handle_event(const jack_data::message_header& header, const unsigned char* bytes)
+  {
+    if (header.size == 0)
+      return;
+
+    RTMIDI17_TRACE_SCOPE("jack::handle_event");
+    inputData_.thru.forward(bytes, header.size, int64_t(header.time));
+    if (!header.deliver)
+      return;
+
+    // The messages were filtered by the process callback. A JACK port
+    // does not tell the senders apart: its sysex are reassembled as if
+    // they all came from the same one.
+    if (bytes[0] == 0xF0 || bytes[0] < 0x80)
+    {
+      inputData_.sysex.feed(
+          0, bytes, header.size, int64_t(header.time), 1,
+          [&](rtmidi::message& m, uint8_t) { deliver(header, m); });
+      return;
+    }
+
+    auto& m = inputData_.message;
+    m.clear();
+    m.bytes.assign(bytes, bytes + header.size);
+    deliver(header, m);
+  }
+
+  void deliver(const jack_data::message_header& header, rtmidi::message& m)
+  {
+    auto& rtData = inputData_;
+
+    // Compute the delta time.
+    if (rtData.firstMessage == true)
+    {
+      m.timestamp = 0.;
+      rtData.firstMessage = false;
+    }
+    else
+    {
+      m.timestamp = (int64_t(header.time) - int64_t(data.lastTime)) * 0.000001;
+    }
+    data.lastTime = header.time;
+    m.absolute_time = header.time;
+    m.frame = header.frame;
+
+    rtData.deliver(m, int64_t(header.time) * 1000 + clockOffset);
+  }
+
+  uint64_t get_dropped_count() const noexcept override
+  {
+    return data.overflows.load(std::memory_order_relaxed);
   }
 
+  bool connect_realtime_thru(midi_out_api& out) override;
+
+  std::atomic_bool running{false};
+  std::thread thread;
+  std::vector<unsigned char> buffer;
+  std::shared_ptr<jack_client_host> host;
   std::string clientName;
+  int64_t clockOffset{};
   jack_data data;
 };
 
@@ -325,11 +830,16 @@ public:
     midi_out_jack::close_port();
 
     // Cleanup
-    jack_ringbuffer_free(data.buffSize);
-    jack_ringbuffer_free(data.buffMessage);
-    if (data.client)
+    if (host)
     {
-      jack_client_close(data.client);
+      host->remove(&data);
+      host.reset();
+    }
+    if (data.ringbuffer)
+    {
+      jack_ringbuffer_free(data.ringbuffer);
+      jack_ringbuffer_free(data.scheduled);
+      jack_ringbuffer_free(data.thru);
     }
   }
 
@@ -406,63 +916,121 @@ public:
 
   unsigned int get_port_count() override
   {
-    int count = 0;
     connect();
-    if (!data.client)
-      return 0;
-
-    // List of available ports
-    const char** ports
-        = jack_get_ports(data.client, nullptr, JACK_DEFAULT_MIDI_TYPE, JackPortIsInput);
-
-    if (ports == nullptr)
+    if (!host)
       return 0;
-    while (ports[count] != nullptr)
-      count++;
-
-    jack_free(ports);
 
-    return count;
+    return host->destinations.count(data.client);
   }
 
   std::string get_port_name(unsigned int portNumber) override
   {
-    std::string retStr("");
-
     connect();
-
-    // List of available ports
-    const char** ports
-        = jack_get_ports(data.client, nullptr, JACK_DEFAULT_MIDI_TYPE, JackPortIsInput);
+    if (!host)
+      return {};
 
     // Check port validity
-    if (ports == nullptr)
+    if (host->destinations.count(data.client) == 0)
     {
       warning("MidiOutJack::getPortName: no ports available!");
-      return retStr;
+      return {};
     }
 
-    if (ports[portNumber] == nullptr)
+    auto name = host->destinations.name(data.client, portNumber);
+    if (!name)
     {
       std::ostringstream ost;
       ost << "MidiOutJack::getPortName: the 'portNumber' argument (" << portNumber
           << ") is invalid.";
       warning(ost.str());
+      return {};
     }
-    else
-      retStr.assign(ports[portNumber]);
 
-    jack_free(ports);
-    return retStr;
+    return *name;
   }
 
   void send_message(const unsigned char* message, size_t size) override
   {
-    int nBytes = static_cast<int>(size);
+    schedule_message(0, message, size);
+  }
+
+  void schedule_message(int64_t timestamp, const unsigned char* message, size_t size) override
+  {
+    if (!data.ringbuffer)
+      return;
 
-    // Write full message to buffer
-    jack_ringbuffer_write(data.buffMessage, (const char*)message, nBytes);
-    jack_ringbuffer_write(data.buffSize, (char*)&nBytes, sizeof(nBytes));
+    const auto ringbuffer = timestamp > 0 ? data.scheduled : data.ringbuffer;
+    const auto total = sizeof(jack_data::message_header) + size;
+    if (jack_ringbuffer_write_space(ringbuffer) < total)
+    {
+      data.overflows.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    jack_record_writer w{ringbuffer};
+    w.write({jack_time_t(std::max(timestamp, int64_t{0})), 0, uint32_t(size)}, message);
+    w.commit();
+  }
+
+  void send_messages(const rtmidi::message* messages, size_t count) override
+  {
+    if (!data.ringbuffer)
+      return;
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++)
+      total += sizeof(jack_data::message_header) + messages[i].size();
+
+    // All the messages are queued, or none of them.
+    if (jack_ringbuffer_write_space(data.ringbuffer) < total)
+    {
+      data.overflows.fetch_add(count, std::memory_order_relaxed);
+      return;
+    }
+
+    jack_record_writer w{data.ringbuffer};
+    for (size_t i = 0; i < count; i++)
+      w.write({0, 0, uint32_t(messages[i].size())}, messages[i].bytes.data());
+    w.commit();
+  }
+
+  //! Queues a message forwarded by thru from the process callback of an
+  //! input of the same client.
+  void send_thru(const unsigned char* message, size_t size) noexcept
+  {
+    if (!data.thru)
+      return;
+
+    if (jack_ringbuffer_write_space(data.thru) < sizeof(jack_data::message_header) + size)
+    {
+      data.overflows.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    jack_record_writer w{data.thru};
+    w.write({0, 0, uint32_t(size)}, message);
+    w.commit();
+  }
+
+  jack_client_t* client() const noexcept
+  {
+    return data.client;
+  }
+
+  uint64_t get_dropped_count() const noexcept override
+  {
+    return data.overflows.load(std::memory_order_relaxed)
+           + data.oversized.load(std::memory_order_relaxed);
+  }
+
+  int64_t get_current_time() const noexcept override
+  {
+    return jack_get_time();
+  }
+
+  bool has_native_scheduling() const noexcept override
+  {
+    return true;
   }
 
 private:
@@ -470,23 +1038,30 @@ private:
 
   void connect()
   {
-    if (data.client)
+    if (host)
       return;
 
-    // Initialize output ringbuffers
-    data.buffSize = jack_ringbuffer_create(jack_data::ringbuffer_size);
-    data.buffMessage = jack_ringbuffer_create(jack_data::ringbuffer_size);
+    // Initialize output ringbuffer
+    if (!data.ringbuffer)
+    {
+      data.ringbuffer = jack_ringbuffer_create(jack_data::ringbuffer_size);
+      jack_ringbuffer_mlock(data.ringbuffer);
+      data.scheduled = jack_ringbuffer_create(jack_data::ringbuffer_size);
+      jack_ringbuffer_mlock(data.scheduled);
+      data.thru = jack_ringbuffer_create(jack_data::ringbuffer_size);
+      jack_ringbuffer_mlock(data.thru);
+    }
 
     // Initialize JACK client
-    data.client = jack_client_open(clientName.c_str(), JackNoStartServer, nullptr);
-    if (data.client == nullptr)
+    host = jack_client_host::acquire(clientName);
+    if (!host)
     {
       warning("MidiOutJack::initialize: JACK server not running?");
       return;
     }
 
-    jack_set_process_callback(data.client, jackProcessOut, &data);
-    jack_activate(data.client);
+    data.client = host->client();
+    host->add(jackProcessOut, &data);
   }
 
   static int jackProcessOut(jack_nframes_t nframes, void* arg)
@@ -500,14 +1075,12 @@ private:
     void* buff = jack_port_get_buffer(data.port, nframes);
     jack_midi_clear_buffer(buff);
 
-    while (jack_ringbuffer_read_space(data.buffSize) > 0)
-    {
-      int space{};
-      jack_ringbuffer_read(data.buffSize, (char*)&space, sizeof(int));
-      auto midiData = jack_midi_event_reserve(buff, 0, space);
-
-      jack_ringbuffer_read(data.buffMessage, (char*)midiData, space);
-    }
+    // The immediate messages go first, at the start of the cycle: the
+    // scheduled ones can only come at or after them.
+    cycle c{data, buff, jack_last_frame_time(data.client), nframes};
+    c.drain(data.ringbuffer);
+    c.drain(data.thru);
+    c.drain(data.scheduled);
 
     if (!data.sem_needpost.try_wait())
       data.sem_cleanup.notify();
@@ -515,9 +1088,82 @@ private:
     return 0;
   }
 
+  //! Copies queued messages to the JACK buffer of a cycle, in order.
+  struct cycle
+  {
+    jack_data& data;
+    void* buff{};
+    jack_nframes_t start{};
+    jack_nframes_t nframes{};
+    jack_nframes_t last_offset{};
+    bool reserved{};
+
+    void drain(jack_ringbuffer_t* ringbuffer)
+    {
+      jack_data::message_header header;
+      while (jack_ringbuffer_read_space(ringbuffer) >= sizeof(header))
+      {
+        jack_ringbuffer_peek(ringbuffer, (char*)&header, sizeof(header));
+
+        // Convert the target time into an offset in the current cycle.
+        // Late messages go at the start of the cycle, and messages meant
+        // for a later cycle stay in the ringbuffer along with the ones
+        // after them.
+        if (header.size == 0)
+        {
+          jack_ringbuffer_read_advance(ringbuffer, sizeof(header));
+          continue;
+        }
+
+        jack_nframes_t offset = last_offset;
+        if (header.time != 0)
+        {
+          const auto frame = jack_time_to_frames(data.client, header.time);
+          const auto delta = static_cast<int32_t>(frame - start);
+          if (delta >= static_cast<int32_t>(nframes))
+            break;
+          if (delta > static_cast<int32_t>(last_offset))
+            offset = delta;
+        }
+
+        auto midiData = jack_midi_event_reserve(buff, offset, header.size);
+        if (!midiData)
+        {
+          // The JACK buffer is full: the message stays queued for the next
+          // cycle, unless it would not even fit in an empty buffer.
+          if (reserved)
+            break;
+
+          jack_ringbuffer_read_advance(ringbuffer, sizeof(header) + header.size);
+          data.oversized.fetch_add(1, std::memory_order_relaxed);
+          continue;
+        }
+
+        jack_ringbuffer_read_advance(ringbuffer, sizeof(header));
+        jack_ringbuffer_read(ringbuffer, (char*)midiData, header.size);
+        last_offset = offset;
+        reserved = true;
+      }
+    }
+  };
+
   jack_data data;
+  std::shared_ptr<jack_client_host> host;
 };
 
+inline void jack_send_thru(midi_out_api& out, const unsigned char* message, size_t size) noexcept
+{
+  static_cast<midi_out_jack&>(out).send_thru(message, size);
+}
+
+inline bool midi_in_jack::connect_realtime_thru(midi_out_api& out)
+{
+  // The ports of a client are processed one after the other by its
+  // process thread, which is then the only writer of the thru ringbuffer.
+  auto jack_out = dynamic_cast<midi_out_jack*>(&out);
+  return jack_out && data.client && jack_out->client() == data.client;
+}
+
 struct jack_backend
 {
   using midi_in = midi_in_jack;
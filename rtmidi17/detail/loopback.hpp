@@ -0,0 +1,457 @@
+#pragma once
+#include <rtmidi17/detail/midi_api.hpp>
+#include <rtmidi17/rtmidi17.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+//*********************************************************************//
+//  API: IN-PROCESS LOOPBACK
+//
+//  Virtual ports live in a process-global bus_. A midi_out connected to
+//  a virtual midi_in (or a midi_in connected to a virtual midi_out)
+//  delivers its messages synchronously, from the sending thread, through
+//  the usual queue and callback paths of the midi_in.
+//
+//  A callback can send to loopback ports: a message which comes back to
+//  an input whose delivery is in progress on the same thread is delivered
+//  after the callback returns. Two threads must not send along a cycle
+//  of loopback ports, since each waits for the delivery of the other.
+//
+//*********************************************************************//
+
+namespace rtmidi
+{
+class midi_in_loopback;
+
+//! Receiving end of the connections to a midi_in. Senders may keep it
+//! alive after the midi_in is gone, in which case input is null.
+struct loopback_receiver
+{
+  void deliver(const unsigned char* bytes, size_t size, int64_t time);
+
+  std::mutex mutex;
+  midi_in_loopback* input{};
+
+  //! Messages sent back to this receiver from its own delivery, by the
+  //! thread which holds the mutex.
+  std::vector<message> pending;
+
+  // Protected by the bus mutex
+  std::string name;
+  bool is_virtual{};
+};
+
+//! Sending end of a midi_out. The list of targets is never modified in
+//! place, but replaced: senders copy the current one with
+//! std::atomic_load. It is not lock-free with the usual standard
+//! libraries, libstdc++ takes one of its spinlocks, but it is held only
+//! for the copy and never while the list is rebuilt.
+struct loopback_source
+{
+  using targets_t = std::vector<std::shared_ptr<loopback_receiver>>;
+
+  void send(const unsigned char* bytes, size_t size, int64_t time)
+  {
+    const auto t = std::atomic_load(&targets);
+    for (const auto& receiver : *t)
+      receiver->deliver(bytes, size, time);
+  }
+
+  // Must be called with the bus mutex
+  void connect(const std::shared_ptr<loopback_receiver>& receiver)
+  {
+    auto t = std::make_shared<targets_t>(*std::atomic_load(&targets));
+    t->push_back(receiver);
+    std::atomic_store(&targets, std::shared_ptr<const targets_t>{std::move(t)});
+  }
+
+  // Must be called with the bus mutex
+  void disconnect(const loopback_receiver* receiver)
+  {
+    auto t = std::make_shared<targets_t>(*std::atomic_load(&targets));
+    t->erase(
+        std::remove_if(
+            t->begin(), t->end(), [=](const auto& r) { return r.get() == receiver; }),
+        t->end());
+    std::atomic_store(&targets, std::shared_ptr<const targets_t>{std::move(t)});
+  }
+
+  std::shared_ptr<const targets_t> targets{std::make_shared<targets_t>()};
+
+  // Protected by the bus mutex
+  std::string name;
+  bool is_virtual{};
+};
+
+//! A list of loopback ports. The loopback API uses a process-global one.
+class loopback_bus
+{
+public:
+  static loopback_bus& instance()
+  {
+    static loopback_bus bus;
+    return bus;
+  }
+
+  std::mutex mutex;
+  std::vector<std::shared_ptr<loopback_source>> sources;
+  std::vector<std::shared_ptr<loopback_receiver>> receivers;
+
+  //! The n-th element of the list which has a virtual port open
+  template <typename T>
+  static T* find_virtual(const std::vector<std::shared_ptr<T>>& list, unsigned int n)
+  {
+    for (const auto& p : list)
+    {
+      if (p->is_virtual && n-- == 0)
+        return p.get();
+    }
+    return nullptr;
+  }
+
+  template <typename T>
+  static unsigned int count_virtual(const std::vector<std::shared_ptr<T>>& list)
+  {
+    return std::count_if(list.begin(), list.end(), [](const auto& p) { return p->is_virtual; });
+  }
+
+  template <typename T>
+  static void remove(std::vector<std::shared_ptr<T>>& list, const T* p)
+  {
+    list.erase(
+        std::remove_if(list.begin(), list.end(), [=](const auto& e) { return e.get() == p; }),
+        list.end());
+  }
+
+  std::shared_ptr<loopback_receiver> get_receiver(const loopback_receiver* r)
+  {
+    for (const auto& p : receivers)
+      if (p.get() == r)
+        return p;
+    return {};
+  }
+};
+
+class observer_loopback final : public observer_api
+{
+public:
+  observer_loopback(observer::callbacks&& c) : observer_api{std::move(c)}
+  {
+  }
+
+  ~observer_loopback()
+  {
+  }
+};
+
+class midi_in_loopback : public midi_in_api
+{
+public:
+  midi_in_loopback(std::string_view clientName, unsigned int queueSizeLimit)
+      : midi_in_loopback{loopback_bus::instance(), rtmidi::API::LOOPBACK, clientName,
+                         queueSizeLimit}
+  {
+  }
+
+  ~midi_in_loopback() override
+  {
+    midi_in_loopback::close_port();
+
+    {
+      std::lock_guard<std::mutex> lock{bus_.mutex};
+      for (auto& source : bus_.sources)
+        source->disconnect(receiver_.get());
+      bus_.remove(bus_.receivers, receiver_.get());
+    }
+
+    // Wait for any message being delivered
+    std::lock_guard<std::mutex> lock{receiver_->mutex};
+    receiver_->input = nullptr;
+  }
+
+  rtmidi::API get_current_api() const noexcept override
+  {
+    return api_;
+  }
+
+  void open_port(unsigned int portNumber, std::string_view /*portName*/) override
+  {
+    if (connected_)
+    {
+      warning("midi_in_loopback::open_port: a valid connection already exists!");
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock{bus_.mutex};
+    auto source = bus_.find_virtual(bus_.sources, portNumber);
+    if (!source)
+    {
+      std::ostringstream ost;
+      ost << "midi_in_loopback::open_port: the 'portNumber' argument (" << portNumber
+          << ") is invalid.";
+      error<invalid_parameter_error>(ost.str());
+      return;
+    }
+
+    source->connect(receiver_);
+    connection_ = source;
+    connected_ = true;
+  }
+
+  void open_virtual_port(std::string_view portName) override
+  {
+    std::lock_guard<std::mutex> lock{bus_.mutex};
+    receiver_->name = clientName_ + ":" + std::string{portName};
+    receiver_->is_virtual = true;
+  }
+
+  void close_port() override
+  {
+    if (!connected_)
+      return;
+
+    std::lock_guard<std::mutex> lock{bus_.mutex};
+    for (auto& source : bus_.sources)
+    {
+      if (source.get() == connection_)
+        source->disconnect(receiver_.get());
+    }
+    connection_ = nullptr;
+    connected_ = false;
+  }
+
+  void set_client_name(std::string_view clientName) override
+  {
+    clientName_ = clientName;
+  }
+
+  void set_port_name(std::string_view portName) override
+  {
+    std::lock_guard<std::mutex> lock{bus_.mutex};
+    receiver_->name = clientName_ + ":" + std::string{portName};
+  }
+
+  unsigned int get_port_count() override
+  {
+    std::lock_guard<std::mutex> lock{bus_.mutex};
+    return bus_.count_virtual(bus_.sources);
+  }
+
+  std::string get_port_name(unsigned int portNumber) override
+  {
+    std::lock_guard<std::mutex> lock{bus_.mutex};
+    if (auto source = bus_.find_virtual(bus_.sources, portNumber))
+      return source->name;
+
+    std::ostringstream ost;
+    ost << "midi_in_loopback::get_port_name: the 'portNumber' argument (" << portNumber
+        << ") is invalid.";
+    warning(ost.str());
+    return {};
+  }
+
+  //! Called from the sending thread, with the receiver mutex held.
+  void handle(const unsigned char* bytes, size_t size, int64_t time)
+  {
+    dispatch_message(bytes, size, time);
+  }
+
+protected:
+  //! For back-ends which reuse the loopback mechanism with their own ports
+  midi_in_loopback(
+      loopback_bus& bus, rtmidi::API api, std::string_view clientName,
+      unsigned int queueSizeLimit)
+      : midi_in_api{nullptr, queueSizeLimit}, bus_{bus}, api_{api}, clientName_{clientName}
+  {
+    receiver_ = std::make_shared<loopback_receiver>();
+    receiver_->input = this;
+
+    std::lock_guard<std::mutex> lock{bus_.mutex};
+    bus_.receivers.push_back(receiver_);
+  }
+
+private:
+  loopback_bus& bus_;
+  const rtmidi::API api_;
+  std::string clientName_;
+  std::shared_ptr<loopback_receiver> receiver_;
+  loopback_source* connection_{};
+};
+
+inline void loopback_receiver::deliver(const unsigned char* bytes, size_t size, int64_t time)
+{
+  // The receivers whose delivery is in progress on this thread
+  struct delivery
+  {
+    const loopback_receiver* receiver;
+    delivery* next;
+  };
+  static thread_local delivery* current{};
+
+  for (auto d = current; d; d = d->next)
+  {
+    if (d->receiver == this)
+    {
+      // Sent back from a callback: locking again would deadlock.
+      auto& m = pending.emplace_back();
+      m.bytes.assign(bytes, bytes + size);
+      m.absolute_time = time;
+      return;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock{mutex};
+  if (!input)
+    return;
+
+  delivery self{this, current};
+  current = &self;
+  struct restore
+  {
+    delivery& self;
+    std::vector<message>& pending;
+    ~restore()
+    {
+      current = self.next;
+      pending.clear();
+    }
+  } r{self, pending};
+
+  input->handle(bytes, size, time);
+
+  // The callbacks of these messages can queue more of them.
+  for (std::size_t i = 0; i < pending.size(); i++)
+  {
+    const auto m = pending[i];
+    input->handle(m.bytes.data(), m.bytes.size(), m.absolute_time);
+  }
+}
+
+class midi_out_loopback : public midi_out_api
+{
+public:
+  explicit midi_out_loopback(std::string_view clientName)
+      : midi_out_loopback{loopback_bus::instance(), rtmidi::API::LOOPBACK, clientName}
+  {
+  }
+
+  ~midi_out_loopback() override
+  {
+    std::lock_guard<std::mutex> lock{bus_.mutex};
+    bus_.remove(bus_.sources, source_.get());
+  }
+
+  rtmidi::API get_current_api() const noexcept override
+  {
+    return api_;
+  }
+
+  void open_port(unsigned int portNumber, std::string_view /*portName*/) override
+  {
+    if (connected_)
+    {
+      warning("midi_out_loopback::open_port: a valid connection already exists!");
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock{bus_.mutex};
+    auto receiver = bus_.find_virtual(bus_.receivers, portNumber);
+    if (!receiver)
+    {
+      std::ostringstream ost;
+      ost << "midi_out_loopback::open_port: the 'portNumber' argument (" << portNumber
+          << ") is invalid.";
+      error<invalid_parameter_error>(ost.str());
+      return;
+    }
+
+    source_->connect(bus_.get_receiver(receiver));
+    connection_ = receiver;
+    connected_ = true;
+  }
+
+  void open_virtual_port(std::string_view portName) override
+  {
+    std::lock_guard<std::mutex> lock{bus_.mutex};
+    source_->name = clientName_ + ":" + std::string{portName};
+    source_->is_virtual = true;
+  }
+
+  void close_port() override
+  {
+    if (!connected_)
+      return;
+
+    std::lock_guard<std::mutex> lock{bus_.mutex};
+    source_->disconnect(connection_);
+    connection_ = nullptr;
+    connected_ = false;
+  }
+
+  void set_client_name(std::string_view clientName) override
+  {
+    clientName_ = clientName;
+  }
+
+  void set_port_name(std::string_view portName) override
+  {
+    std::lock_guard<std::mutex> lock{bus_.mutex};
+    source_->name = clientName_ + ":" + std::string{portName};
+  }
+
+  unsigned int get_port_count() override
+  {
+    std::lock_guard<std::mutex> lock{bus_.mutex};
+    return bus_.count_virtual(bus_.receivers);
+  }
+
+  std::string get_port_name(unsigned int portNumber) override
+  {
+    std::lock_guard<std::mutex> lock{bus_.mutex};
+    if (auto receiver = bus_.find_virtual(bus_.receivers, portNumber))
+      return receiver->name;
+
+    std::ostringstream ost;
+    ost << "midi_out_loopback::get_port_name: the 'portNumber' argument (" << portNumber
+        << ") is invalid.";
+    warning(ost.str());
+    return {};
+  }
+
+  void send_message(const unsigned char* message, size_t size) override
+  {
+    source_->send(message, size, get_current_time());
+  }
+
+protected:
+  //! For back-ends which reuse the loopback mechanism with their own ports
+  midi_out_loopback(loopback_bus& bus, rtmidi::API api, std::string_view clientName)
+      : bus_{bus}, api_{api}, clientName_{clientName}
+  {
+    source_ = std::make_shared<loopback_source>();
+
+    std::lock_guard<std::mutex> lock{bus_.mutex};
+    bus_.sources.push_back(source_);
+  }
+
+  loopback_bus& bus_;
+  const rtmidi::API api_;
+  std::string clientName_;
+  std::shared_ptr<loopback_source> source_;
+
+private:
+  const loopback_receiver* connection_{};
+};
+
+struct loopback_backend
+{
+  using midi_in = midi_in_loopback;
+  using midi_out = midi_out_loopback;
+  using midi_observer = observer_loopback;
+  static const constexpr auto API = rtmidi::API::LOOPBACK;
+};
+}
@@ -1,7 +1,18 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <rtmidi17/detail/input_filter.hpp>
+#include <rtmidi17/detail/port_counters.hpp>
+#include <rtmidi17/detail/sysex_assembler.hpp>
 #include <rtmidi17/rtmidi17.hpp>
+#include <rtmidi17/trace.hpp>
 #include <string_view>
+#include <vector>
 
 namespace rtmidi
 {
@@ -95,6 +106,153 @@ protected:
   mutable bool firstErrorOccurred_{};
 };
 
+class midi_in_api;
+class midi_out_api;
+
+//! Serializes the changes to the thru routes, which are recorded both by
+//! the input and by the output.
+inline std::mutex& thru_mutex() noexcept
+{
+  static std::mutex mutex;
+  return mutex;
+}
+
+//! The outputs to which an input forwards its messages from the input
+//! path of its back-end. The list is never modified in place, so that
+//! forward() takes no lock: a new one is swapped in, and the old one is
+//! freed once no message is being forwarded with it.
+class thru_list
+{
+public:
+  struct route
+  {
+    midi_out_api* out{};
+    std::shared_ptr<compiled_filter> filter; // shared by the copies; null to accept all
+    midi_in::thru_transform transform;
+    bool native{};   // routed by the back-end itself, without forward()
+    bool realtime{}; // forwarded by forward_realtime() rather than forward()
+  };
+
+  thru_list() = default;
+  ~thru_list()
+  {
+    delete routes_.load();
+  }
+
+  thru_list(const thru_list&) = delete;
+  thru_list(thru_list&&) = delete;
+  thru_list& operator=(const thru_list&) = delete;
+  thru_list& operator=(thru_list&&) = delete;
+
+  //! Adds a route, or replaces the route to the same output.
+  void set(route r)
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    // Nothing is being forwarded without routes: the scratch message can
+    // be sized for the usual messages before forward() uses it.
+    if (!routes_.load())
+      scratch_.bytes.reserve(scratch_capacity);
+
+    auto routes = copy();
+    auto it = std::find_if(
+        routes->begin(), routes->end(), [&](const route& other) { return other.out == r.out; });
+    if (it != routes->end())
+      *it = std::move(r);
+    else
+      routes->push_back(std::move(r));
+    publish(std::move(routes));
+  }
+
+  void remove(const midi_out_api& out)
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto routes = copy();
+    routes->erase(
+        std::remove_if(
+            routes->begin(), routes->end(), [&](const route& r) { return r.out == &out; }),
+        routes->end());
+    publish(std::move(routes));
+  }
+
+  std::vector<route> get() const
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return *copy();
+  }
+
+  //! True if there are routes: the input must then decode the messages
+  //! which its own filter drops.
+  bool active() const noexcept
+  {
+    return routes_.load(std::memory_order_relaxed) != nullptr;
+  }
+
+  //! True if forward() has routes to handle. Back-ends which forward
+  //! from a realtime thread must then pass forward() all the messages,
+  //! even those which their own filter drops.
+  bool deferred() const noexcept
+  {
+    return deferred_.load(std::memory_order_relaxed);
+  }
+
+  //! Called by the thread which receives the messages of the input, with
+  //! their time in microseconds. Skips the native and realtime routes.
+  inline void forward(const unsigned char* bytes, size_t size, int64_t time);
+
+  //! Called by the realtime thread of the back-end for the realtime
+  //! routes, which have no transform: send(out, bytes, size) must neither
+  //! lock nor allocate.
+  template <typename Send>
+  void forward_realtime(const unsigned char* bytes, size_t size, int64_t time, Send&& send)
+  {
+    if (!routes_.load(std::memory_order_relaxed))
+      return;
+
+    forwarding_.fetch_add(1);
+    if (const auto routes = routes_.load())
+    {
+      for (const auto& r : *routes)
+        if (r.realtime && accepts(r, bytes, size, time))
+          send(*r.out, bytes, size);
+    }
+    forwarding_.fetch_sub(1);
+  }
+
+private:
+  std::unique_ptr<std::vector<route>> copy() const
+  {
+    const auto current = routes_.load();
+    return current ? std::make_unique<std::vector<route>>(*current)
+                   : std::make_unique<std::vector<route>>();
+  }
+
+  static bool accepts(const route& r, const unsigned char* bytes, size_t size, int64_t time)
+  {
+    return !r.filter || r.filter->accept(bytes[0], size > 1 ? bytes[1] : 0, time);
+  }
+
+  void publish(std::unique_ptr<std::vector<route>> routes)
+  {
+    using namespace std::literals;
+    if (routes->empty())
+      routes.reset();
+    deferred_ = routes && std::any_of(routes->begin(), routes->end(), [](const route& r) {
+                  return !r.native && !r.realtime;
+                });
+    std::unique_ptr<std::vector<route>> old{routes_.exchange(routes.release())};
+    while (forwarding_ > 0)
+      std::this_thread::sleep_for(100us);
+  }
+
+  static constexpr std::size_t scratch_capacity = 256;
+
+  mutable std::mutex mutex_;
+  std::atomic<std::vector<route>*> routes_{};
+  std::atomic_bool deferred_{};
+  std::atomic<int> forwarding_{}; // the input thread and a realtime one may forward at once
+  message scratch_;               // for transforms, only used by forward()
+};
+
 class midi_in_api : public midi_api
 {
 public:
@@ -108,7 +266,7 @@ public:
       inputData_.queue.ring = std::make_unique<rtmidi::message[]>(inputData_.queue.ringSize);
     }
   }
-  ~midi_in_api() override = default;
+  inline ~midi_in_api() override;
 
   midi_in_api(const midi_in_api&) = delete;
   midi_in_api(midi_in_api&&) = delete;
@@ -117,21 +275,32 @@ public:
 
   virtual void ignore_types(bool midiSysex, bool midiTime, bool midiSense)
   {
-    inputData_.ignoreFlags = 0;
-    if (midiSysex)
-    {
-      inputData_.ignoreFlags = 0x01;
-    }
-    if (midiTime)
-    {
-      inputData_.ignoreFlags |= 0x02;
-    }
-    if (midiSense)
-    {
-      inputData_.ignoreFlags |= 0x04;
-    }
+    std::lock_guard<std::mutex> lock{filterMutex_};
+    auto f = filter_;
+    f.accept(message_type::SYSTEM_EXCLUSIVE, !midiSysex);
+    f.accept(message_type::TIME_CODE, !midiTime);
+    f.accept(message_type::TIME_CLOCK, !midiTime);
+    f.accept(message_type::RESERVED3, !midiTime);
+    f.accept(message_type::ACTIVE_SENSING, !midiSense);
+    apply_filter(f);
+  }
+
+  void set_filter(const input_filter& f)
+  {
+    std::lock_guard<std::mutex> lock{filterMutex_};
+    apply_filter(f);
+  }
+
+  void set_sysex_limits(const sysex_limits& limits) noexcept
+  {
+    inputData_.sysex.set_limits(limits);
   }
 
+  inline void
+  add_thru(midi_out_api& out, const input_filter& filter, midi_in::thru_transform transform);
+
+  inline void remove_thru(midi_out_api& out);
+
   void set_callback(midi_in::message_callback callback)
   {
     inputData_.userCallback = std::move(callback);
@@ -153,11 +322,25 @@ public:
     message m;
     if (inputData_.queue.pop(m))
     {
+      inputData_.stats.popped();
       return m;
     }
     return {};
   }
 
+  port_statistics get_statistics() const noexcept
+  {
+    auto s = inputData_.stats.snapshot();
+    s.dropped += inputData_.sysex.dropped() + get_dropped_count();
+    return s;
+  }
+
+  //! Messages dropped by the back-end before reaching the input thread
+  virtual uint64_t get_dropped_count() const noexcept
+  {
+    return 0;
+  }
+
   struct midi_queue
   {
     unsigned int front{};
@@ -167,6 +350,7 @@ public:
 
     bool push(const message& msg)
     {
+      RTMIDI17_TRACE_SCOPE("midi_queue::push");
       auto [sz, _, b] = get_dimensions();
 
       if (sz < ringSize - 1)
@@ -180,6 +364,7 @@ public:
     }
     bool pop(message& msg)
     {
+      RTMIDI17_TRACE_SCOPE("midi_queue::pop");
       auto [sz, f, _] = get_dimensions();
 
       if (sz == 0)
@@ -215,24 +400,359 @@ public:
   {
     midi_queue queue{};
     rtmidi::message message{};
+    compiled_filter filter{};
+    thru_list thru{};
+    sysex_assembler sysex{};
     unsigned char ignoreFlags{7};
     bool doInput{false};
     bool firstMessage{true};
     void* apiData{};
     midi_in::message_callback userCallback{};
     bool continueSysex{false};
+    int64_t lastTime{};
+    port_counters stats{};
+
+    //! Passes a message to the callback or the queue, and counts it.
+    //! `received` is the time at which the driver received it, in
+    //! nanoseconds on the clock of port_counters::now(), if known.
+    void deliver(rtmidi::message& m, int64_t received = -1)
+    {
+      RTMIDI17_TRACE_SCOPE("midi_in::deliver");
+      const auto start = stats.start();
+      if (start >= 0 && received >= 0)
+        stats.delayed(start - received);
+
+      const auto size = m.bytes.size();
+      if (userCallback)
+      {
+        RTMIDI17_TRACE_SCOPE("midi_in::callback");
+        userCallback(m);
+      }
+      else if (queue.push(m))
+      {
+        stats.pushed();
+      }
+      else
+      {
+        // The queue size limit is reached.
+        stats.dropped();
+        std::cerr << "\nrtmidi17: message queue limit reached!!\n\n";
+        return;
+      }
+      stats.processed(size, start);
+    }
   };
 
 protected:
+  //! Back-ends which can route messages between ports themselves do so
+  //! for the thru outputs which take all the messages unchanged.
+  virtual bool connect_thru(midi_out_api& /*out*/)
+  {
+    return false;
+  }
+
+  virtual void disconnect_thru(midi_out_api& /*out*/)
+  {
+  }
+
+  //! Back-ends whose input path runs in a realtime thread forward from it,
+  //! with thru_list::forward_realtime(), the unchanged messages of the
+  //! routes to outputs which can queue them without lock nor allocation.
+  virtual bool connect_realtime_thru(midi_out_api& /*out*/)
+  {
+    return false;
+  }
+
+  //! Forwards the messages of the routes which were native from the
+  //! input path, for instance when the back-end closes the port.
+  void unroute_native_thru()
+  {
+    std::lock_guard<std::mutex> lock{thru_mutex()};
+    for (auto r : inputData_.thru.get())
+    {
+      if (r.native)
+      {
+        disconnect_thru(*r.out);
+        r.native = false;
+        inputData_.thru.set(std::move(r));
+      }
+    }
+  }
+
+  //! Used by back-ends which receive complete messages: forwards the
+  //! message to the thru outputs, applies the filter, computes the delta
+  //! time from the absolute time in microseconds, and passes the message
+  //! to the callback or the queue.
+  void dispatch_message(const unsigned char* bytes, size_t size, int64_t time)
+  {
+    if (size == 0)
+      return;
+
+    RTMIDI17_TRACE_SCOPE("midi_in::dispatch_message");
+    inputData_.thru.forward(bytes, size, time);
+    if (!inputData_.filter.accept(bytes[0], size > 1 ? bytes[1] : 0, time))
+      return;
+
+    auto& m = inputData_.message;
+    m.bytes.assign(bytes, bytes + size);
+
+    // Compute the delta time.
+    if (inputData_.firstMessage)
+    {
+      m.timestamp = 0.;
+      inputData_.firstMessage = false;
+    }
+    else
+    {
+      m.timestamp = (time - inputData_.lastTime) * 0.000001;
+    }
+    inputData_.lastTime = time;
+    m.absolute_time = time;
+
+    inputData_.deliver(m, steadyTime_ ? time * 1000 : -1);
+  }
+
   in_data inputData_{};
+  input_filter filter_{};
+
+  //! Serializes the writers of filter_ and inputData_.filter, which can
+  //! be called from any thread. The receiving thread does not take it.
+  std::mutex filterMutex_;
+
+  //! Whether the times given to dispatch_message() are on the steady clock
+  bool steadyTime_{true};
+
+private:
+  friend class midi_out_api;
+
+  //! Changes the filter, with filterMutex_ held.
+  void apply_filter(const input_filter& f)
+  {
+    filter_ = f;
+    inputData_.filter.set(f);
+
+    // For the back-ends which do not evaluate the whole filter
+    const auto ignored = [&](message_type t) { return !(f.types & input_filter::type_bit(t)); };
+    unsigned char flags = 0;
+    if (ignored(message_type::SYSTEM_EXCLUSIVE))
+      flags |= 0x01;
+    if (ignored(message_type::TIME_CLOCK))
+      flags |= 0x02;
+    if (ignored(message_type::ACTIVE_SENSING))
+      flags |= 0x04;
+    inputData_.ignoreFlags = flags;
+  }
+
+  //! Removes the route to an output, with thru_mutex() held.
+  inline void erase_thru(midi_out_api& out);
 };
 
 class midi_out_api : public midi_api
 {
 public:
   virtual void send_message(const unsigned char* message, size_t size) = 0;
+
+  //! Back-ends which cannot schedule output send the message immediately.
+  virtual void schedule_message(int64_t /*timestamp*/, const unsigned char* message, size_t size)
+  {
+    send_message(message, size);
+  }
+
+  //! Back-ends which cannot queue a batch atomically send messages one by one.
+  virtual void send_messages(const rtmidi::message* messages, size_t count)
+  {
+    for (size_t i = 0; i < count; i++)
+      send_message(messages[i].bytes.data(), messages[i].bytes.size());
+  }
+
+  virtual uint64_t get_dropped_count() const noexcept
+  {
+    return 0;
+  }
+
+  //! send_message(), counted in the statistics of the port
+  void send_counted(const unsigned char* message, size_t size)
+  {
+    RTMIDI17_TRACE_SCOPE("midi_out::send_message");
+    serialized([&] {
+      const auto start = stats_.start();
+      send_message(message, size);
+      stats_.processed(size, start);
+    });
+  }
+
+  void schedule_counted(int64_t timestamp, const unsigned char* message, size_t size)
+  {
+    RTMIDI17_TRACE_SCOPE("midi_out::schedule_message");
+    serialized([&] {
+      const auto start = stats_.start();
+      schedule_message(timestamp, message, size);
+      stats_.processed(size, start);
+    });
+  }
+
+  void send_counted(const rtmidi::message* messages, size_t count)
+  {
+    RTMIDI17_TRACE_SCOPE("midi_out::send_messages");
+    serialized([&] {
+      const auto start = stats_.start();
+      send_messages(messages, count);
+
+      std::size_t size = 0;
+      for (size_t i = 0; i < count; i++)
+        size += messages[i].bytes.size();
+      stats_.processed(size, start, count);
+    });
+  }
+
+  //! Records an input with a thru route to this output, with thru_mutex()
+  //! held.
+  void attach_thru(midi_in_api* in)
+  {
+    thruInputs_.push_back(in);
+    thruWriters_.store(int(thruInputs_.size()), std::memory_order_relaxed);
+  }
+
+  void detach_thru(midi_in_api* in)
+  {
+    thruInputs_.erase(std::remove(thruInputs_.begin(), thruInputs_.end(), in), thruInputs_.end());
+    thruWriters_.store(int(thruInputs_.size()), std::memory_order_relaxed);
+  }
+
+  //! Removes the thru routes to this output, before it is closed or
+  //! destroyed. The inputs no longer use it once this returns.
+  void remove_thru_routes()
+  {
+    std::lock_guard<std::mutex> lock{thru_mutex()};
+    const auto inputs = thruInputs_;
+    for (auto in : inputs)
+      in->erase_thru(*this);
+  }
+
+  port_statistics get_statistics() const noexcept
+  {
+    auto s = stats_.snapshot();
+    s.dropped += get_dropped_count();
+    return s;
+  }
+
+  virtual int64_t get_current_time() const noexcept
+  {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+  }
+
+  virtual bool has_native_scheduling() const noexcept
+  {
+    return false;
+  }
+
+protected:
+  port_counters stats_{};
+
+private:
+  //! The threads of the inputs with thru routes to this output send to it
+  //! too: only then are the sends and their counters serialized. The lock
+  //! is recursive for the callbacks of the loopback API, which may send
+  //! again to the same output.
+  template <typename F>
+  void serialized(F&& f)
+  {
+    if (thruWriters_.load(std::memory_order_relaxed) == 0)
+      return f();
+
+    std::lock_guard<std::recursive_mutex> lock{sendMutex_};
+    f();
+  }
+
+  std::recursive_mutex sendMutex_;
+  std::vector<midi_in_api*> thruInputs_; // guarded by thru_mutex()
+  std::atomic<int> thruWriters_{};
 };
 
+inline void thru_list::forward(const unsigned char* bytes, size_t size, int64_t time)
+{
+  // Cheap check for the common case of an input without thru.
+  if (!deferred_.load(std::memory_order_relaxed))
+    return;
+
+  forwarding_.fetch_add(1);
+  if (const auto routes = routes_.load())
+  {
+    for (const auto& r : *routes)
+    {
+      if (r.native || r.realtime || !accepts(r, bytes, size, time))
+        continue;
+
+      if (!r.transform)
+      {
+        r.out->send_counted(bytes, size);
+        continue;
+      }
+
+      scratch_.bytes.assign(bytes, bytes + size);
+      if (r.transform(scratch_))
+        r.out->send_counted(scratch_.bytes.data(), scratch_.bytes.size());
+    }
+  }
+  forwarding_.fetch_sub(1);
+}
+
+inline midi_in_api::~midi_in_api()
+{
+  // The back-end has stopped receiving: nothing is being forwarded.
+  std::lock_guard<std::mutex> lock{thru_mutex()};
+  for (const auto& r : inputData_.thru.get())
+    r.out->detach_thru(this);
+}
+
+inline void midi_in_api::add_thru(
+    midi_out_api& out, const input_filter& filter, midi_in::thru_transform transform)
+{
+  std::lock_guard<std::mutex> lock{thru_mutex()};
+  erase_thru(out);
+
+  thru_list::route r;
+  r.out = &out;
+  if (!filter.accepts_all())
+  {
+    r.filter = std::make_shared<compiled_filter>();
+    r.filter->set(filter);
+  }
+  r.transform = std::move(transform);
+
+  // Native routing can only forward all the messages, unchanged.
+  r.native = !r.transform && filter.accepts_all() && connect_thru(out);
+  r.realtime = !r.native && !r.transform && connect_realtime_thru(out);
+  inputData_.thru.set(std::move(r));
+  out.attach_thru(this);
+}
+
+inline void midi_in_api::remove_thru(midi_out_api& out)
+{
+  std::lock_guard<std::mutex> lock{thru_mutex()};
+  erase_thru(out);
+}
+
+inline void midi_in_api::erase_thru(midi_out_api& out)
+{
+  bool found = false;
+  for (const auto& r : inputData_.thru.get())
+  {
+    if (r.out == &out)
+    {
+      found = true;
+      if (r.native)
+        disconnect_thru(out);
+    }
+  }
+  if (!found)
+    return;
+
+  inputData_.thru.remove(out);
+  out.detach_thru(this);
+}
+
 template <typename T>
 class midi_in_default : public midi_in_api
 {
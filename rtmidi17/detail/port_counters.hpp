@@ -0,0 +1,178 @@
+#pragma once
+#include <rtmidi17/port_statistics.hpp>
+
+#include <atomic>
+#include <chrono>
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#endif
+
+namespace rtmidi
+{
+#if !defined(RTMIDI17_NO_STATISTICS)
+//! The counters behind port_statistics. Each counter is only written by
+//! one thread at a time: the one which receives the messages, the one
+//! which pops the input queue, or the one which sends to an output, whose
+//! sends are serialized while thru routes target it. Increments are plain
+//! relaxed loads and stores, without read-modify-write. snapshot() can be
+//! called from any thread.
+class port_counters
+{
+public:
+  static constexpr bool enabled = true;
+  static constexpr uint32_t sample_period = 16;
+
+  //! Time in nanoseconds on the steady clock
+  static int64_t now() noexcept
+  {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+  }
+
+  //! Called before processing a message: returns now(), or a negative
+  //! value if the message is not timed. Reading the clock costs more than
+  //! all the counters, so the histograms only sample one message out of
+  //! sample_period.
+  int64_t start() noexcept
+  {
+    return (tick_++ & (sample_period - 1)) == 0 ? now() : -1;
+  }
+
+  //! Counts messages delivered or sent, whose processing started when
+  //! start() was called.
+  void processed(std::size_t size, int64_t start, uint64_t messages = 1) noexcept
+  {
+    add(messages_, messages);
+    add(bytes_, size);
+    if (start >= 0)
+      record(processing_, now() - start);
+  }
+
+  //! Delay between the reception of a message by the driver and now(),
+  //! in nanoseconds.
+  void delayed(int64_t delay) noexcept
+  {
+    record(delay_, delay);
+  }
+
+  void dropped(uint64_t n = 1) noexcept
+  {
+    add(dropped_, n);
+  }
+
+  void error() noexcept
+  {
+    add(errors_, 1);
+  }
+
+  void pushed() noexcept
+  {
+    add(pushed_, 1);
+  }
+
+  void popped() noexcept
+  {
+    add(popped_, 1);
+  }
+
+  port_statistics snapshot() const noexcept
+  {
+    port_statistics s;
+    s.time = now() / 1000;
+    s.messages = messages_.load(std::memory_order_relaxed);
+    s.bytes = bytes_.load(std::memory_order_relaxed);
+    s.dropped = dropped_.load(std::memory_order_relaxed);
+    s.errors = errors_.load(std::memory_order_relaxed);
+    const auto popped = popped_.load(std::memory_order_relaxed);
+    const auto pushed = pushed_.load(std::memory_order_relaxed);
+    s.queue_depth = pushed > popped ? pushed - popped : 0;
+    for (int i = 0; i < latency_histogram::bucket_count; i++)
+    {
+      s.processing.counts[i] = processing_[i].load(std::memory_order_relaxed);
+      s.delay.counts[i] = delay_[i].load(std::memory_order_relaxed);
+    }
+    return s;
+  }
+
+  static int bucket(uint64_t ns) noexcept
+  {
+    constexpr int bits = latency_histogram::sub_bucket_bits;
+    if (ns < latency_histogram::sub_buckets)
+      return int(ns);
+
+#  if defined(_MSC_VER)
+    unsigned long msb;
+    _BitScanReverse64(&msb, ns);
+#  else
+    const int msb = 63 - __builtin_clzll(ns);
+#  endif
+    const int index = int(msb - bits + 1) * latency_histogram::sub_buckets
+                      + int((ns >> (msb - bits)) & (latency_histogram::sub_buckets - 1));
+    return index < latency_histogram::bucket_count ? index : latency_histogram::bucket_count - 1;
+  }
+
+private:
+  using counter = std::atomic<uint64_t>;
+
+  static void add(counter& c, uint64_t n) noexcept
+  {
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  static void record(counter (&histogram)[latency_histogram::bucket_count], int64_t ns) noexcept
+  {
+    add(histogram[bucket(ns > 0 ? uint64_t(ns) : 0)], 1);
+  }
+
+  uint32_t tick_{}; // written along with the other counters
+  counter messages_{};
+  counter bytes_{};
+  counter dropped_{};
+  counter errors_{};
+  counter pushed_{};
+  counter popped_{};
+  counter processing_[latency_histogram::bucket_count]{};
+  counter delay_[latency_histogram::bucket_count]{};
+};
+#else
+//! Statistics are disabled: nothing is counted, and the clock is not
+//! even read.
+class port_counters
+{
+public:
+  static constexpr bool enabled = false;
+
+  static int64_t now() noexcept
+  {
+    return 0;
+  }
+  int64_t start() noexcept
+  {
+    return -1;
+  }
+  void processed(std::size_t, int64_t, uint64_t = 1) noexcept
+  {
+  }
+  void delayed(int64_t) noexcept
+  {
+  }
+  void dropped(uint64_t = 1) noexcept
+  {
+  }
+  void error() noexcept
+  {
+  }
+  void pushed() noexcept
+  {
+  }
+  void popped() noexcept
+  {
+  }
+  port_statistics snapshot() const noexcept
+  {
+    return {};
+  }
+};
+#endif
+}
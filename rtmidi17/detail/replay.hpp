@@ -0,0 +1,254 @@
+#pragma once
+#include <rtmidi17/detail/midi_api.hpp>
+#include <rtmidi17/replay.hpp>
+#include <rtmidi17/rtmidi17.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <sstream>
+#include <thread>
+
+//*********************************************************************//
+//  API: FILE REPLAY
+//
+//  The input ports are the files registered with add_replay_file().
+//  Opening a port starts a thread which delivers the recorded messages
+//  at absolute deadlines computed from the start of the replay, so that
+//  timing errors do not accumulate over long sessions.
+//
+//*********************************************************************//
+
+namespace rtmidi
+{
+class observer_replay final : public observer_api
+{
+public:
+  observer_replay(observer::callbacks&& c) : observer_api{std::move(c)}
+  {
+  }
+
+  ~observer_replay()
+  {
+  }
+};
+
+class midi_in_replay final : public midi_in_api
+{
+public:
+  midi_in_replay(std::string_view /*clientName*/, unsigned int queueSizeLimit)
+      : midi_in_api{nullptr, queueSizeLimit}
+  {
+  }
+
+  ~midi_in_replay() override
+  {
+    midi_in_replay::close_port();
+  }
+
+  rtmidi::API get_current_api() const noexcept override
+  {
+    return rtmidi::API::REPLAY;
+  }
+
+  void open_port(unsigned int portNumber, std::string_view /*portName*/) override
+  {
+    if (connected_)
+    {
+      warning("midi_in_replay::open_port: a valid connection already exists!");
+      return;
+    }
+
+    file_ = get_file(portNumber);
+    if (!file_)
+    {
+      std::ostringstream ost;
+      ost << "midi_in_replay::open_port: the 'portNumber' argument (" << portNumber
+          << ") is invalid.";
+      error<invalid_parameter_error>(ost.str());
+      return;
+    }
+
+    // The statistics of a file describe the replay of a single input.
+    if (!file_->acquire())
+    {
+      file_.reset();
+      error<invalid_use_error>(
+          "midi_in_replay::open_port: the file is already replayed by another input.");
+      return;
+    }
+
+    running_ = true;
+    thread_ = std::thread{[this] { replay(); }};
+    connected_ = true;
+  }
+
+  void open_virtual_port(std::string_view /*portName*/) override
+  {
+    warning("midi_in_replay::open_virtual_port: virtual ports are not supported.");
+  }
+
+  void close_port() override
+  {
+    if (!connected_)
+      return;
+
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      running_ = false;
+    }
+    cv_.notify_one();
+    thread_.join();
+
+    file_->release();
+    file_.reset();
+    connected_ = false;
+  }
+
+  void set_client_name(std::string_view /*clientName*/) override
+  {
+  }
+
+  void set_port_name(std::string_view /*portName*/) override
+  {
+  }
+
+  unsigned int get_port_count() override
+  {
+    auto& registry = replay_registry::instance();
+    std::lock_guard<std::mutex> lock{registry.mutex};
+    return registry.files.size();
+  }
+
+  std::string get_port_name(unsigned int portNumber) override
+  {
+    if (auto file = get_file(portNumber))
+      return file->name();
+
+    std::ostringstream ost;
+    ost << "midi_in_replay::get_port_name: the 'portNumber' argument (" << portNumber
+        << ") is invalid.";
+    warning(ost.str());
+    return {};
+  }
+
+private:
+  static std::shared_ptr<replay_file> get_file(unsigned int portNumber)
+  {
+    auto& registry = replay_registry::instance();
+    std::lock_guard<std::mutex> lock{registry.mutex};
+    if (portNumber < registry.files.size())
+      return registry.files[portNumber];
+    return {};
+  }
+
+  void replay()
+  {
+    using namespace std::chrono;
+    using clk = steady_clock;
+
+    auto& file = *file_;
+    const auto& events = file.events();
+    const double speed = file.options().speed;
+    const bool fast = speed <= 0.;
+
+    file.reset_stats();
+    if (events.empty())
+      return;
+
+    const auto start = clk::now();
+    const auto to_us = [](clk::duration d) { return duration_cast<microseconds>(d).count(); };
+
+    // Offset of the current pass, in microseconds of file time
+    int64_t offset = 0;
+    for (;;)
+    {
+      for (const auto& e : events)
+      {
+        int64_t lateness = 0;
+        if (fast)
+        {
+          if (!running_)
+            return;
+        }
+        else
+        {
+          const auto deadline
+              = start + duration_cast<clk::duration>(microseconds(offset + e.time) / speed);
+          std::unique_lock<std::mutex> lock{mutex_};
+          if (cv_.wait_until(lock, deadline, [this] { return !running_; }))
+            return;
+          lateness = to_us(clk::now() - deadline);
+        }
+
+        const auto now = clk::now();
+        dispatch_message(e.bytes.data(), e.bytes.size(), to_us(now.time_since_epoch()));
+        file.record_message(to_us(now - start), lateness);
+      }
+
+      file.record_loop();
+      // A file whose events all happen at once would be delivered again
+      // and again without ever waiting: it is only played once.
+      if (!file.options().loop || file.duration() <= 0)
+        return;
+
+      offset += file.duration();
+    }
+  }
+
+  std::shared_ptr<replay_file> file_;
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::atomic_bool running_{};
+};
+
+class midi_out_replay final : public midi_out_api
+{
+public:
+  explicit midi_out_replay(std::string_view /*clientName*/)
+  {
+  }
+
+  rtmidi::API get_current_api() const noexcept override
+  {
+    return rtmidi::API::REPLAY;
+  }
+
+  void open_port(unsigned int /*portNumber*/, std::string_view /*portName*/) override
+  {
+    error<invalid_use_error>("midi_out_replay::open_port: the replay API has no output.");
+  }
+  void open_virtual_port(std::string_view /*portName*/) override
+  {
+    error<invalid_use_error>("midi_out_replay::open_virtual_port: the replay API has no output.");
+  }
+  void close_port() override
+  {
+  }
+  void set_client_name(std::string_view /*clientName*/) override
+  {
+  }
+  void set_port_name(std::string_view /*portName*/) override
+  {
+  }
+  unsigned int get_port_count() override
+  {
+    return 0;
+  }
+  std::string get_port_name(unsigned int /*portNumber*/) override
+  {
+    return {};
+  }
+  void send_message(const unsigned char* /*message*/, size_t /*size*/) override
+  {
+  }
+};
+
+struct replay_backend
+{
+  using midi_in = midi_in_replay;
+  using midi_out = midi_out_replay;
+  using midi_observer = observer_replay;
+  static const constexpr auto API = rtmidi::API::REPLAY;
+};
+}
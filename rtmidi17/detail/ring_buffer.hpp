@@ -0,0 +1,81 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace rtmidi
+{
+//! A lock-free byte ring buffer between a single producer thread and a
+//! single consumer thread. Neither side ever blocks nor allocates.
+class ring_buffer
+{
+public:
+  //! The capacity is rounded up to a power of two.
+  explicit ring_buffer(std::size_t capacity)
+  {
+    std::size_t size = 64;
+    while (size < capacity)
+      size *= 2;
+    data_ = std::make_unique<uint8_t[]>(size);
+    mask_ = size - 1;
+  }
+
+  std::size_t write_space() const noexcept
+  {
+    const auto used
+        = head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_acquire);
+    return mask_ + 1 - used;
+  }
+
+  std::size_t read_space() const noexcept
+  {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_relaxed);
+  }
+
+  //! Writes two buffers one after the other, or nothing at all if there
+  //! is not enough space for both.
+  bool write(
+      const void* first, std::size_t firstSize, const void* second,
+      std::size_t secondSize) noexcept
+  {
+    if (write_space() < firstSize + secondSize)
+      return false;
+
+    const auto head = head_.load(std::memory_order_relaxed);
+    copy_in(head, first, firstSize);
+    copy_in(head + firstSize, second, secondSize);
+    head_.store(head + firstSize + secondSize, std::memory_order_release);
+    return true;
+  }
+
+  //! Reads bytes which read_space() reported as available.
+  void read(void* dest, std::size_t size) noexcept
+  {
+    const auto tail = tail_.load(std::memory_order_relaxed);
+    const auto pos = tail & mask_;
+    const auto part = std::min(size, mask_ + 1 - pos);
+    std::memcpy(dest, data_.get() + pos, part);
+    std::memcpy(static_cast<uint8_t*>(dest) + part, data_.get(), size - part);
+    tail_.store(tail + size, std::memory_order_release);
+  }
+
+private:
+  void copy_in(std::size_t at, const void* src, std::size_t size) noexcept
+  {
+    if (size == 0)
+      return;
+    const auto pos = at & mask_;
+    const auto part = std::min(size, mask_ + 1 - pos);
+    std::memcpy(data_.get() + pos, src, part);
+    std::memcpy(data_.get(), static_cast<const uint8_t*>(src) + part, size - part);
+  }
+
+  std::unique_ptr<uint8_t[]> data_;
+  std::size_t mask_{};
+  alignas(64) std::atomic<std::size_t> head_{}; // only written by the producer
+  alignas(64) std::atomic<std::size_t> tail_{}; // only written by the consumer
+};
+}
@@ -2,6 +2,20 @@
 #include <condition_variable>
 #include <mutex>
 
+#if defined(__APPLE__)
+#  include <dispatch/dispatch.h>
+#elif defined(_WIN32)
+#  if !defined(NOMINMAX)
+#    define NOMINMAX 1
+#  endif
+#  if !defined(WIN32_LEAN_AND_MEAN)
+#    define WIN32_LEAN_AND_MEAN 1
+#  endif
+#  include <windows.h>
+#else
+#  include <semaphore.h>
+#endif
+
 // Based on https://stackoverflow.com/a/27852868/1495627
 namespace rtmidi
 {
@@ -73,4 +87,72 @@ private:
   std::condition_variable cv_;
   size_t count_;
 };
+
+//! A semaphore which a realtime thread can notify without ever blocking
+//! nor losing the notification: it is the one of the operating system,
+//! whose post does not take a lock.
+class rt_semaphore
+{
+public:
+  rt_semaphore()
+  {
+#if defined(__APPLE__)
+    sem_ = dispatch_semaphore_create(0);
+#elif defined(_WIN32)
+    sem_ = CreateSemaphore(nullptr, 0, LONG_MAX, nullptr);
+#else
+    sem_init(&sem_, 0, 0);
+#endif
+  }
+
+  ~rt_semaphore()
+  {
+#if defined(__APPLE__)
+    dispatch_release(sem_);
+#elif defined(_WIN32)
+    CloseHandle(sem_);
+#else
+    sem_destroy(&sem_);
+#endif
+  }
+
+  rt_semaphore(const rt_semaphore&) = delete;
+  rt_semaphore(rt_semaphore&&) = delete;
+  rt_semaphore& operator=(const rt_semaphore&) = delete;
+  rt_semaphore& operator=(rt_semaphore&&) = delete;
+
+  void notify() noexcept
+  {
+#if defined(__APPLE__)
+    dispatch_semaphore_signal(sem_);
+#elif defined(_WIN32)
+    ReleaseSemaphore(sem_, 1, nullptr);
+#else
+    sem_post(&sem_);
+#endif
+  }
+
+  void wait() noexcept
+  {
+#if defined(__APPLE__)
+    dispatch_semaphore_wait(sem_, DISPATCH_TIME_FOREVER);
+#elif defined(_WIN32)
+    WaitForSingleObject(sem_, INFINITE);
+#else
+    while (sem_wait(&sem_) != 0)
+    {
+      // Interrupted by a signal
+    }
+#endif
+  }
+
+private:
+#if defined(__APPLE__)
+  dispatch_semaphore_t sem_;
+#elif defined(_WIN32)
+  HANDLE sem_;
+#else
+  sem_t sem_;
+#endif
+};
 }
@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace rtmidi
+{
+//! Publishes a trivially copyable value from a single writer thread to
+//! any number of reader threads. Neither side ever blocks: readers retry
+//! in the rare case where the value changed while they were reading it.
+template <typename T>
+class seqlock
+{
+  static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+  void store(const T& value) noexcept
+  {
+    uint64_t buffer[words]{};
+    std::memcpy(buffer, &value, sizeof(T));
+
+    const auto seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (std::size_t i = 0; i < words; i++)
+      data_[i].store(buffer[i], std::memory_order_relaxed);
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+
+  T load() const noexcept
+  {
+    uint64_t buffer[words];
+    uint32_t before, after;
+    do
+    {
+      before = seq_.load(std::memory_order_acquire);
+      for (std::size_t i = 0; i < words; i++)
+        buffer[i] = data_[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = seq_.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    T value;
+    std::memcpy(&value, buffer, sizeof(T));
+    return value;
+  }
+
+private:
+  static constexpr std::size_t words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  std::atomic<uint32_t> seq_{};
+  std::atomic<uint64_t> data_[words]{};
+};
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <rtmidi17/detail/loopback.hpp>
+#include <rtmidi17/simulated_clock.hpp>
+
+//*********************************************************************//
+//  API: SIMULATED
+//
+//  Loopback ports whose time is given by the simulated_clock, so that
+//  timing behaviour can be tested deterministically.
+//
+//*********************************************************************//
+
+namespace rtmidi
+{
+class midi_in_simulated final : public midi_in_loopback
+{
+public:
+  midi_in_simulated(std::string_view clientName, unsigned int queueSizeLimit)
+      : midi_in_loopback{simulated_clock::instance().bus(), rtmidi::API::SIMULATED, clientName,
+                         queueSizeLimit}
+  {
+    steadyTime_ = false;
+  }
+};
+
+class midi_out_simulated final : public midi_out_loopback
+{
+public:
+  explicit midi_out_simulated(std::string_view clientName)
+      : midi_out_loopback{simulated_clock::instance().bus(), rtmidi::API::SIMULATED, clientName}
+  {
+  }
+
+  void send_message(const unsigned char* message, size_t size) override
+  {
+    source_->send(message, size, simulated_clock::instance().now());
+  }
+
+  void schedule_message(int64_t timestamp, const unsigned char* message, size_t size) override
+  {
+    simulated_clock::instance().schedule(source_, timestamp, message, size);
+  }
+
+  int64_t get_current_time() const noexcept override
+  {
+    return simulated_clock::instance().now();
+  }
+
+  bool has_native_scheduling() const noexcept override
+  {
+    return true;
+  }
+};
+
+struct simulated_backend
+{
+  using midi_in = midi_in_simulated;
+  using midi_out = midi_out_simulated;
+  using midi_observer = observer_loopback;
+  static const constexpr auto API = rtmidi::API::SIMULATED;
+};
+}
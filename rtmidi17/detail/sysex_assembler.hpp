@@ -0,0 +1,174 @@
+#pragma once
+#include <rtmidi17/message.hpp>
+#include <rtmidi17/sysex_limits.hpp>
+
+#include <atomic>
+#include <cstdint>
+
+namespace rtmidi
+{
+//! Reassembles the sysex messages which back-ends receive in several
+//! parts, separately for each source: a sysex from a sender is not
+//! corrupted by another one interleaved on the same port. Used by the
+//! thread which receives the messages of an input; the limits can be
+//! changed from any other thread.
+class sysex_assembler
+{
+public:
+  //! Number of sources which can send a sysex at the same time. Beyond
+  //! that, the oldest pending sysex is dropped.
+  static constexpr int max_sources = 16;
+
+  void set_limits(const sysex_limits& limits) noexcept
+  {
+    maxSize_.store(limits.max_size, std::memory_order_relaxed);
+    timeout_.store(limits.timeout, std::memory_order_relaxed);
+    chunkSize_.store(limits.chunk_size, std::memory_order_relaxed);
+  }
+
+  //! Feeds a part of a sysex from a source, received at the given time in
+  //! microseconds: the first part starts with 0xF0, the last one ends with
+  //! 0xF7. deliver(message&, flags) is called with the complete message,
+  //! or with each chunk, and the flags given with the first part. The
+  //! parts of a sysex started with null flags are dropped without being
+  //! copied, like those of a sysex which exceeds the limits, and parts
+  //! which continue no sysex.
+  template <typename F>
+  void feed(
+      uint32_t source, const unsigned char* bytes, std::size_t size, int64_t time, uint8_t flags,
+      F&& deliver)
+  {
+    if (size == 0)
+      return;
+
+    const auto timeout = timeout_.load(std::memory_order_relaxed);
+    slot* s = find(source);
+    if (bytes[0] == 0xF0)
+    {
+      // The previous sysex of the source never ended.
+      if (s)
+        drop(*s);
+
+      expire(time, timeout);
+      if (flags == 0)
+        return;
+
+      s = acquire(source);
+      s->flags = flags;
+    }
+    else if (!s)
+    {
+      return;
+    }
+    else if (timeout > 0 && time - s->last > timeout)
+    {
+      drop(*s);
+      return;
+    }
+    s->last = time;
+
+    const bool last = bytes[size - 1] == 0xF7;
+    const auto chunkSize = chunkSize_.load(std::memory_order_relaxed);
+    auto& m = s->msg;
+    if (chunkSize == 0 && m.bytes.size() + size > maxSize_.load(std::memory_order_relaxed))
+    {
+      drop(*s);
+      return;
+    }
+
+    m.bytes.insert(m.bytes.end(), bytes, bytes + size);
+    if (last || (chunkSize > 0 && m.bytes.size() >= chunkSize))
+    {
+      deliver(m, s->flags);
+      m.bytes.clear();
+    }
+
+    if (last)
+      release(*s);
+  }
+
+  //! Number of sysex dropped because of the limits, or never ended.
+  uint64_t dropped() const noexcept
+  {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct slot
+  {
+    message msg; // its buffer is kept from one sysex to the next
+    int64_t last{};
+    uint32_t source{};
+    uint8_t flags{};
+    bool active{};
+  };
+
+  slot* find(uint32_t source) noexcept
+  {
+    if (active_ == 0)
+      return nullptr;
+    for (auto& s : slots_)
+      if (s.active && s.source == source)
+        return &s;
+    return nullptr;
+  }
+
+  slot* acquire(uint32_t source) noexcept
+  {
+    slot* oldest = &slots_[0];
+    for (auto& s : slots_)
+    {
+      if (!s.active)
+      {
+        oldest = &s;
+        break;
+      }
+      if (s.last < oldest->last)
+        oldest = &s;
+    }
+    if (oldest->active)
+      drop(*oldest);
+
+    oldest->active = true;
+    oldest->source = source;
+    active_++;
+    return oldest;
+  }
+
+  void expire(int64_t time, int64_t timeout) noexcept
+  {
+    if (timeout <= 0 || active_ == 0)
+      return;
+    for (auto& s : slots_)
+      if (s.active && time - s.last > timeout)
+        drop(s);
+  }
+
+  void drop(slot& s) noexcept
+  {
+    // Only written by the receiving thread
+    dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    release(s);
+  }
+
+  void release(slot& s) noexcept
+  {
+    // Do not keep the memory of a large dump.
+    if (s.msg.bytes.capacity() > buffer_capacity)
+      s.msg.bytes = midi_bytes{};
+    s.msg.bytes.clear();
+    s.active = false;
+    active_--;
+  }
+
+  static constexpr std::size_t buffer_capacity = 65536;
+
+  std::atomic<std::size_t> maxSize_{sysex_limits{}.max_size};
+  std::atomic<int64_t> timeout_{sysex_limits{}.timeout};
+  std::atomic<std::size_t> chunkSize_{sysex_limits{}.chunk_size};
+
+  slot slots_[max_sources];
+  int active_{};
+  std::atomic<uint64_t> dropped_{};
+};
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <rtmidi17/message.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+namespace rtmidi
+{
+/**********************************************************************/
+/*! \class input_filter
+    \brief Describes the messages delivered by a midi_in: see
+    midi_in::set_filter().
+
+    Message types are identified by a bit in a mask: the seven channel
+    message types first, then the sixteen system message types from 0xF0
+    to 0xFF. The default filter accepts everything but sysex, time code,
+    timing clock and tick, and active sensing, like
+    midi_in::ignore_types() with its default arguments.
+*/
+/**********************************************************************/
+struct input_filter
+{
+  static constexpr int type_count = 23;
+  static constexpr uint32_t all_types = (uint32_t(1) << type_count) - 1;
+
+  //! Index of the type of the message starting with a status byte.
+  static constexpr int type_index(uint8_t status) noexcept
+  {
+    return status < 0xF0 ? (status >> 4) - 8 : 7 + (status & 0x0F);
+  }
+
+  static constexpr uint32_t type_bit(message_type type) noexcept
+  {
+    return uint32_t(1) << type_index(uint8_t(type));
+  }
+
+  //! Sysex (0xF0), time code (0xF1), timing clock (0xF8) and tick (0xF9),
+  //! and active sensing (0xFE)
+  static constexpr uint32_t default_ignored
+      = (1 << 7) | (1 << 8) | (1 << 15) | (1 << 16) | (1 << 21);
+
+  //! Accepted types, one bit per type_index()
+  uint32_t types{all_types & ~default_ignored};
+
+  //! Accepted channels for channel messages, one bit per channel, the
+  //! lowest for the first channel.
+  uint16_t channels{0xFFFF};
+
+  //! Range of accepted notes, for note on, note off and polyphonic
+  //! pressure messages.
+  uint8_t lowest_note{0};
+  uint8_t highest_note{127};
+
+  //! Range of accepted controllers, for control change messages.
+  uint8_t lowest_control{0};
+  uint8_t highest_control{127};
+
+  //! Maximum number of messages per second of each type, for instance to
+  //! thin out aftertouch. Messages which come sooner than 1 / rate after
+  //! the last accepted one of their type are dropped. Zero means
+  //! unlimited.
+  float max_rate[type_count]{};
+
+  //! Accepts or drops a type of message.
+  input_filter& accept(message_type type, bool enable = true) noexcept
+  {
+    if (enable)
+      types |= type_bit(type);
+    else
+      types &= ~type_bit(type);
+    return *this;
+  }
+
+  input_filter& limit_rate(message_type type, float messagesPerSecond) noexcept
+  {
+    max_rate[type_index(uint8_t(type))] = messagesPerSecond;
+    return *this;
+  }
+
+  //! True if no message is dropped
+  bool accepts_all() const noexcept
+  {
+    if (types != all_types || channels != 0xFFFF || lowest_note != 0 || highest_note != 127
+        || lowest_control != 0 || highest_control != 127)
+      return false;
+    return std::none_of(max_rate, max_rate + type_count, [](float r) { return r > 0.f; });
+  }
+
+  //! A filter which accepts all messages
+  static input_filter all() noexcept
+  {
+    input_filter f;
+    f.types = all_types;
+    return f;
+  }
+};
+}
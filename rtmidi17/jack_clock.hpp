@@ -0,0 +1,213 @@
+#pragma once
+#include <rtmidi17/detail/jack.hpp>
+
+#include <cmath>
+
+namespace rtmidi
+{
+/**********************************************************************/
+/*! \class jack_clock
+    \brief A MIDI clock generator locked to the JACK transport.
+
+    This class registers a JACK MIDI output port and generates, inside
+    the process callback, 24 PPQN clock messages as well as start, stop,
+    continue and song position pointer messages following the state of
+    the JACK transport. Each clock is written at its exact frame offset
+    in the cycle.
+
+    When a timebase master provides BBT information, its tempo and
+    position are followed. Otherwise the position is derived from the
+    transport frame and the tempo given to set_tempo().
+*/
+/**********************************************************************/
+class jack_clock
+{
+public:
+  jack_clock(std::string_view clientName, std::string_view portName)
+  {
+    host_ = jack_client_host::acquire(std::string{clientName});
+    if (!host_)
+      throw driver_error("jack_clock: JACK server not running?");
+
+    port_ = jack_port_register(
+        host_->client(), portName.data(), JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
+    if (!port_)
+      throw driver_error("jack_clock: JACK error creating port");
+
+    host_->add(process, this);
+  }
+
+  jack_clock() : jack_clock{"RtMidi17 Clock", "clock"}
+  {
+  }
+
+  ~jack_clock()
+  {
+    host_->remove(this);
+    jack_port_unregister(host_->client(), port_);
+  }
+
+  jack_clock(const jack_clock&) = delete;
+  jack_clock(jack_clock&&) = delete;
+  jack_clock& operator=(const jack_clock&) = delete;
+  jack_clock& operator=(jack_clock&&) = delete;
+
+  //! Connects the clock output to the JACK port with the given full name.
+  void connect(std::string_view destination)
+  {
+    jack_connect(host_->client(), jack_port_name(port_), std::string{destination}.c_str());
+  }
+
+  //! Starts the JACK transport.
+  void start_transport()
+  {
+    jack_transport_start(host_->client());
+  }
+
+  //! Stops the JACK transport.
+  void stop_transport()
+  {
+    jack_transport_stop(host_->client());
+  }
+
+  //! Tempo in quarter notes per minute, used when there is no timebase master.
+  void set_tempo(double bpm) noexcept
+  {
+    tempo_ = bpm;
+  }
+
+  double get_tempo() const noexcept
+  {
+    return tempo_;
+  }
+
+  //! Number of clock messages sent since the creation of the clock.
+  uint64_t get_clock_count() const noexcept
+  {
+    return clocks_;
+  }
+
+private:
+  static constexpr double ppqn = 24.;
+
+  static int process(jack_nframes_t nframes, void* arg)
+  {
+    static_cast<jack_clock*>(arg)->run(nframes);
+    return 0;
+  }
+
+  void run(jack_nframes_t nframes)
+  {
+    void* buff = jack_port_get_buffer(port_, nframes);
+    jack_midi_clear_buffer(buff);
+
+    jack_position_t pos;
+    const auto state = jack_transport_query(host_->client(), &pos);
+    const bool rolling = state == JackTransportRolling;
+    if (pos.frame_rate == 0)
+      return;
+
+    // Position in quarter notes at the start of the cycle, and tempo
+    double quarters{};
+    double qpm{};
+    if (pos.valid & JackPositionBBT)
+    {
+      const double beats = (pos.bar - 1) * double(pos.beats_per_bar) + (pos.beat - 1)
+                           + pos.tick / pos.ticks_per_beat;
+      quarters = beats * 4. / pos.beat_type;
+      qpm = pos.beats_per_minute * 4. / pos.beat_type;
+    }
+    else
+    {
+      qpm = tempo_;
+      quarters = pos.frame * qpm / (60. * pos.frame_rate);
+    }
+
+    // While the transport keeps going, we integrate the position ourselves:
+    // this is exact across tempo changes and not subject to the resolution
+    // of BBT ticks. We only resynchronize if the transport was relocated,
+    // or if the timebase master disagrees with us by more than half a clock.
+    bool relocated = pos.frame != nextFrame_;
+    if (rolling && wasRolling_ && !relocated)
+    {
+      if (!(pos.valid & JackPositionBBT) || std::abs(quarters - nextQuarters_) * ppqn < 0.5)
+        quarters = nextQuarters_;
+      else
+        relocated = true;
+    }
+
+    const double cycleQuarters = nframes * qpm / (60. * pos.frame_rate);
+
+    if (rolling && wasRolling_ && relocated)
+    {
+      write(buff, 0, uint8_t(message_type::STOP));
+      write_song_position(buff, quarters);
+      write(buff, 0, uint8_t(message_type::CONTINUE));
+    }
+    else if (rolling && !wasRolling_)
+    {
+      if (quarters == 0.)
+      {
+        write(buff, 0, uint8_t(message_type::START));
+      }
+      else
+      {
+        write_song_position(buff, quarters);
+        write(buff, 0, uint8_t(message_type::CONTINUE));
+      }
+    }
+    else if (!rolling && wasRolling_)
+    {
+      write(buff, 0, uint8_t(message_type::STOP));
+    }
+    else if (!rolling && pos.frame != lastFrame_)
+    {
+      // Relocation while stopped
+      write_song_position(buff, quarters);
+    }
+
+    if (rolling && cycleQuarters > 0.)
+    {
+      // Clocks falling within [quarters, quarters + cycleQuarters[
+      for (double k = std::ceil(quarters * ppqn); k < (quarters + cycleQuarters) * ppqn; k++)
+      {
+        const double offset = (k / ppqn - quarters) / cycleQuarters * nframes;
+        write(
+            buff, std::min(jack_nframes_t(offset), nframes - 1),
+            uint8_t(message_type::TIME_CLOCK));
+        ++clocks_;
+      }
+    }
+
+    wasRolling_ = rolling;
+    lastFrame_ = pos.frame;
+    nextFrame_ = pos.frame + nframes;
+    nextQuarters_ = quarters + cycleQuarters;
+  }
+
+  void write(void* buff, jack_nframes_t offset, uint8_t byte)
+  {
+    jack_midi_event_write(buff, offset, &byte, 1);
+  }
+
+  void write_song_position(void* buff, double quarters)
+  {
+    // The song position pointer counts sixteenth notes.
+    const int sixteenths = int(quarters * 4.);
+    const uint8_t bytes[3]{uint8_t(message_type::SONG_POS_POINTER), uint8_t(sixteenths & 0x7F),
+                           uint8_t((sixteenths >> 7) & 0x7F)};
+    jack_midi_event_write(buff, 0, bytes, 3);
+  }
+
+  std::shared_ptr<jack_client_host> host_;
+  jack_port_t* port_{};
+  std::atomic<double> tempo_{120.};
+  std::atomic<uint64_t> clocks_{};
+
+  // Only accessed from the process callback
+  bool wasRolling_{};
+  jack_nframes_t lastFrame_{};
+  jack_nframes_t nextFrame_{};
+  double nextQuarters_{};
+};
+}
@@ -96,6 +96,13 @@ struct message
   midi_bytes bytes;
   double timestamp{};
 
+  //! Absolute time of the event in microseconds, on the back-end clock.
+  //! Left to zero by back-ends which cannot provide it.
+  int64_t absolute_time{};
+
+  //! Absolute position of the event in frames of the audio clock (JACK only).
+  uint32_t frame{};
+
   message() noexcept = default;
   message(const midi_bytes& src_bytes, double src_timestamp)
       : bytes(src_bytes), timestamp(src_timestamp)
@@ -0,0 +1,144 @@
+#if !defined(RTMIDI17_HEADER_ONLY)
+#  include <rtmidi17/note_tracker.hpp>
+#endif
+
+namespace rtmidi
+{
+RTMIDI17_INLINE
+void note_tracker::process(const message& m) noexcept
+{
+  // Back-ends which do not provide an absolute time only give deltas.
+  lastTime_ += int64_t(m.timestamp * 1e6);
+  process(m.bytes.data(), m.bytes.size(), m.absolute_time != 0 ? m.absolute_time : lastTime_);
+}
+
+RTMIDI17_INLINE
+void note_tracker::process(const unsigned char* bytes, size_t size, int64_t time) noexcept
+{
+  if (size == 0)
+    return;
+
+  const uint8_t status = bytes[0];
+  if (status == 0xFF)
+  {
+    reset();
+    return;
+  }
+  if (size < 3 || status < 0x80 || status >= 0xC0)
+    return;
+
+  auto& c = channels_[status & 0x0F];
+  const uint8_t data1 = bytes[1] & 0x7F;
+  const uint8_t data2 = bytes[2] & 0x7F;
+  const int word = data1 >> 6;
+  const uint64_t bit = uint64_t(1) << (data1 & 63);
+
+  switch (status & 0xF0)
+  {
+    case 0x90:
+      if (data2 != 0)
+      {
+        c.held[word] |= bit;
+        c.sustained[word] &= ~bit;
+        c.velocity[data1] = data2;
+        c.start[data1] = time;
+        break;
+      }
+      [[fallthrough]]; // a note on with a null velocity is a note off
+    case 0x80:
+      if (c.pedal && (c.held[word] & bit))
+        c.sustained[word] |= bit;
+      c.held[word] &= ~bit;
+      break;
+    case 0xB0:
+      control_change(c, data1, data2);
+      break;
+  }
+}
+
+RTMIDI17_INLINE
+void note_tracker::control_change(channel_state& c, uint8_t control, uint8_t value) noexcept
+{
+  switch (control)
+  {
+    case 64: // sustain pedal
+      c.pedal = value >= 64;
+      if (!c.pedal)
+        c.sustained[0] = c.sustained[1] = 0;
+      break;
+    case 120: // all sound off
+      c.held[0] = c.held[1] = 0;
+      c.sustained[0] = c.sustained[1] = 0;
+      break;
+    case 121: // reset all controllers
+      c.pedal = false;
+      c.sustained[0] = c.sustained[1] = 0;
+      break;
+    case 123: // all notes off: like releasing all the keys
+      if (c.pedal)
+      {
+        c.sustained[0] |= c.held[0];
+        c.sustained[1] |= c.held[1];
+      }
+      c.held[0] = c.held[1] = 0;
+      break;
+  }
+}
+
+RTMIDI17_INLINE
+void note_tracker::reset() noexcept
+{
+  for (auto& c : channels_)
+  {
+    c.held[0] = c.held[1] = 0;
+    c.sustained[0] = c.sustained[1] = 0;
+    c.pedal = false;
+  }
+}
+
+RTMIDI17_INLINE
+int note_tracker::count(int channel) const noexcept
+{
+  const auto& c = channels_[index(channel)];
+  return popcount(c.held[0] | c.sustained[0]) + popcount(c.held[1] | c.sustained[1]);
+}
+
+RTMIDI17_INLINE
+int note_tracker::count() const noexcept
+{
+  int n = 0;
+  for (int channel = 1; channel <= 16; channel++)
+    n += count(channel);
+  return n;
+}
+
+RTMIDI17_INLINE
+std::vector<message> note_tracker::release_messages() const
+{
+  std::vector<message> messages;
+  for (int i = 0; i < 16; i++)
+  {
+    const auto& c = channels_[i];
+    const uint8_t channel = uint8_t(i + 1);
+    for (int w = 0; w < 2; w++)
+    {
+      for (uint64_t bits = c.held[w]; bits != 0; bits &= bits - 1)
+        messages.push_back(
+            message::note_off(channel, uint8_t(w * 64 + count_trailing_zeros(bits)), 0));
+    }
+    if (c.pedal)
+      messages.push_back(message::control_change(channel, 64, 0));
+  }
+  return messages;
+}
+
+RTMIDI17_INLINE
+std::size_t note_tracker::panic(midi_out& out)
+{
+  const auto messages = release_messages();
+  if (!messages.empty())
+    out.send_messages(messages);
+  reset();
+  return messages.size();
+}
+}
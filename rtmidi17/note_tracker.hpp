@@ -0,0 +1,165 @@
+#pragma once
+#include <rtmidi17/rtmidi17.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#endif
+
+namespace rtmidi
+{
+/**********************************************************************/
+/*! \class note_tracker
+    \brief Keeps track of the notes sounding on each channel of a MIDI
+    stream.
+
+    Feed it the messages of an input, or the messages sent to an output,
+    to know which notes are held, with their velocity and start time, and
+    which ones are only sustained by the pedal:
+
+    \code
+    rtmidi::note_tracker notes;
+    midiin.set_callback([&](const rtmidi::message& m) { notes.process(m); });
+    // ...
+    notes.panic(midiout);
+    midiout.close_port();
+    \endcode
+
+    The notes of a channel are stored in two 128-bit sets, so that every
+    update is a constant-time bit operation and iterating over the
+    sounding notes only visits them. Channels are numbered from 1 to 16,
+    like in the message factories.
+
+    The tracker is not synchronized: it must be used from a single
+    thread, or guarded by the caller.
+*/
+/**********************************************************************/
+class RTMIDI17_EXPORT note_tracker
+{
+public:
+  note_tracker() = default;
+
+  //! Processes a message. Only notes, the sustain pedal (controller 64),
+  //! all sound off, reset all controllers, all notes off, and system
+  //! reset change the state.
+  void process(const message& m) noexcept;
+
+  //! Processes a message received at the given time, in microseconds.
+  void process(const unsigned char* bytes, size_t size, int64_t time) noexcept;
+
+  //! Forgets all the notes and pedals.
+  void reset() noexcept;
+
+  //! Whether the key of a note is down.
+  bool held(int channel, int note) const noexcept
+  {
+    return test(channels_[index(channel)].held, note);
+  }
+
+  //! Whether a note is held, or was released while the pedal was down.
+  bool sounding(int channel, int note) const noexcept
+  {
+    const auto& c = channels_[index(channel)];
+    return test(c.held, note) || test(c.sustained, note);
+  }
+
+  //! Velocity of the last note on of a sounding note.
+  uint8_t velocity(int channel, int note) const noexcept
+  {
+    return channels_[index(channel)].velocity[note & 0x7F];
+  }
+
+  //! Time of the last note on of a sounding note, in microseconds.
+  int64_t start_time(int channel, int note) const noexcept
+  {
+    return channels_[index(channel)].start[note & 0x7F];
+  }
+
+  bool sustain(int channel) const noexcept
+  {
+    return channels_[index(channel)].pedal;
+  }
+
+  //! Number of sounding notes on a channel.
+  int count(int channel) const noexcept;
+
+  //! Number of sounding notes on all the channels.
+  int count() const noexcept;
+
+  //! Calls f(channel, note) for each sounding note, in ascending order.
+  template <typename F>
+  void for_each(F&& f) const
+  {
+    for (int c = 0; c < 16; c++)
+    {
+      const auto& ch = channels_[c];
+      for (int w = 0; w < 2; w++)
+      {
+        for (uint64_t bits = ch.held[w] | ch.sustained[w]; bits != 0; bits &= bits - 1)
+          f(c + 1, w * 64 + count_trailing_zeros(bits));
+      }
+    }
+  }
+
+  //! The messages which silence all the sounding notes: a note off for
+  //! each held note, and a pedal release for the channels whose pedal is
+  //! down, which releases their sustained notes at once.
+  std::vector<message> release_messages() const;
+
+  //! Sends release_messages() to an output as a single batch, then forgets
+  //! all the notes. Call it before closing a port on which notes may
+  //! still be playing. Returns the number of messages sent.
+  std::size_t panic(midi_out& out);
+
+private:
+  struct channel_state
+  {
+    uint64_t held[2]{};      // keys down
+    uint64_t sustained[2]{}; // keys released while the pedal is down
+    bool pedal{};
+    uint8_t velocity[128]{};
+    int64_t start[128]{};
+  };
+
+  static int index(int channel) noexcept
+  {
+    return (channel - 1) & 0x0F;
+  }
+
+  static bool test(const uint64_t (&bits)[2], int note) noexcept
+  {
+    return (bits[(note >> 6) & 1] >> (note & 63)) & 1;
+  }
+
+  static int count_trailing_zeros(uint64_t bits) noexcept
+  {
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward64(&i, bits);
+    return int(i);
+#else
+    return __builtin_ctzll(bits);
+#endif
+  }
+
+  static int popcount(uint64_t bits) noexcept
+  {
+#if defined(_MSC_VER)
+    return int(__popcnt64(bits));
+#else
+    return __builtin_popcountll(bits);
+#endif
+  }
+
+  void control_change(channel_state& c, uint8_t control, uint8_t value) noexcept;
+
+  channel_state channels_[16];
+  int64_t lastTime_{};
+};
+}
+
+#if defined(RTMIDI17_HEADER_ONLY)
+#  include <rtmidi17/note_tracker.cpp>
+#endif
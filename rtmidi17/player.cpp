@@ -0,0 +1,443 @@
+#if !defined(RTMIDI17_HEADER_ONLY)
+#  include <rtmidi17/player.hpp>
+#endif
+
+#include <algorithm>
+
+namespace rtmidi
+{
+RTMIDI17_INLINE
+player::player(midi_out& out, const reader& song)
+    : out_{out}, tempo_{song}, native_{out.has_native_scheduling()}
+{
+  int lastTick = 0;
+  for (const auto& track : song.tracks)
+  {
+    for (const auto& e : track)
+    {
+      lastTick = std::max(lastTick, e.tick);
+      if (e.m.bytes.empty() || e.m.is_meta_event())
+        continue;
+      events_.push_back({tempo_.time_at(e.tick), e.m.bytes});
+    }
+  }
+  std::stable_sort(events_.begin(), events_.end(), [](const auto& lhs, const auto& rhs) {
+    return lhs.time < rhs.time;
+  });
+  length_ = tempo_.time_at(lastTick);
+  loopEnd_ = length_;
+
+  thread_ = std::thread{[this] { run(); }};
+}
+
+RTMIDI17_INLINE
+player::~player()
+{
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (playing_)
+      halt(out_.get_current_time());
+    running_ = false;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+RTMIDI17_INLINE
+void player::play()
+{
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (playing_)
+      return;
+
+    if (anchorSong_ >= length_)
+      anchorSong_ = 0.;
+    anchorClock_ = start_time();
+    wrap_ = 0.;
+    index_ = first_event(anchorSong_);
+    playing_ = true;
+  }
+  cv_.notify_one();
+}
+
+RTMIDI17_INLINE
+void player::pause()
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (playing_)
+    halt(out_.get_current_time());
+}
+
+RTMIDI17_INLINE
+void player::stop()
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (playing_)
+    halt(out_.get_current_time());
+  anchorSong_ = 0.;
+}
+
+RTMIDI17_INLINE
+void player::seek(double quarters)
+{
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    const double songTime
+        = std::clamp(tempo_.time_at(quarters * tempo_.ticks_per_beat()), 0., length_);
+    const double start = start_time();
+    if (playing_)
+      silence(start);
+    chase(songTime, start);
+
+    anchorSong_ = songTime;
+    anchorClock_ = start;
+    wrap_ = 0.;
+    index_ = first_event(songTime);
+  }
+  cv_.notify_one();
+}
+
+RTMIDI17_INLINE
+double player::get_position() const
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  return tempo_.tick_at(song_time(out_.get_current_time())) / tempo_.ticks_per_beat();
+}
+
+RTMIDI17_INLINE
+double player::get_length() const noexcept
+{
+  return tempo_.tick_at(length_) / tempo_.ticks_per_beat();
+}
+
+RTMIDI17_INLINE
+void player::set_loop(bool enable, double start, double end)
+{
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    const double ticksPerBeat = tempo_.ticks_per_beat();
+    loopStart_ = std::clamp(tempo_.time_at(start * ticksPerBeat), 0., length_);
+    loopEnd_ = end > start ? std::clamp(tempo_.time_at(end * ticksPerBeat), 0., length_) : length_;
+    loop_ = enable && loopEnd_ > loopStart_;
+
+    // A loop which ends before the current position starts right away.
+    const int64_t now = out_.get_current_time();
+    if (loop_ && playing_ && song_time(now) >= loopEnd_)
+    {
+      const double when = start_time();
+      silence(when);
+      anchorSong_ = loopStart_;
+      anchorClock_ = when;
+      wrap_ = 0.;
+      index_ = first_event(loopStart_);
+    }
+  }
+  cv_.notify_one();
+}
+
+RTMIDI17_INLINE
+void player::set_tempo_scale(double scale)
+{
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    scale = std::max(scale, 0.01);
+
+    // Re-anchor after the events already scheduled, so that the position
+    // does not jump. If the anchor is further ahead, a loop was just
+    // restarted: the anchor stays valid with the new scale.
+    const double when = start_time();
+    if (playing_ && when >= anchorClock_)
+    {
+      anchorSong_ += (when - anchorClock_) * scale_;
+      anchorClock_ = when;
+      wrap_ = 0.;
+    }
+    scale_ = scale;
+  }
+  cv_.notify_one();
+}
+
+RTMIDI17_INLINE
+double player::get_tempo_scale() const noexcept
+{
+  return scale_;
+}
+
+RTMIDI17_INLINE
+double player::get_tempo() const
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  return tempo_.tempo_at(tempo_.tick_at(song_time(out_.get_current_time()))) * scale_;
+}
+
+RTMIDI17_INLINE
+void player::set_lookahead(std::chrono::microseconds lookahead)
+{
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    lookahead_ = std::max(int64_t(lookahead.count()), int64_t(1000));
+  }
+  cv_.notify_one();
+}
+
+RTMIDI17_INLINE
+void player::set_spin_time(std::chrono::microseconds spin)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  spin_ = std::max(int64_t(spin.count()), int64_t(0));
+}
+
+RTMIDI17_INLINE
+bool player::is_playing() const noexcept
+{
+  return playing_;
+}
+
+RTMIDI17_INLINE
+player_stats player::get_stats() const
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto s = stats_;
+  if (s.events > 0)
+    s.mean_lateness = latenessSum_ / s.events;
+  return s;
+}
+
+RTMIDI17_INLINE
+void player::reset_stats()
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  stats_ = {};
+  latenessSum_ = 0.;
+}
+
+RTMIDI17_INLINE
+double player::song_time(int64_t now) const noexcept
+{
+  if (!playing_)
+    return anchorSong_;
+
+  const double t = anchorSong_ + (now - anchorClock_) * scale_;
+  if (now < anchorClock_)
+    return std::max(0., t + wrap_);
+  return std::min(t, length_);
+}
+
+RTMIDI17_INLINE
+double player::clock_time(double songTime) const noexcept
+{
+  return anchorClock_ + (songTime - anchorSong_) / scale_;
+}
+
+RTMIDI17_INLINE
+std::size_t player::first_event(double songTime) const noexcept
+{
+  return std::lower_bound(
+             events_.begin(), events_.end(), songTime,
+             [](const event& e, double t) { return e.time < t; })
+         - events_.begin();
+}
+
+RTMIDI17_INLINE
+double player::start_time() const
+{
+  // Messages must be scheduled in order: start after those already scheduled.
+  return std::max(double(out_.get_current_time()), lastScheduled_);
+}
+
+RTMIDI17_INLINE
+void player::send(double due, int64_t now, const unsigned char* bytes, size_t size)
+{
+  const double lateness = std::max(0., now - due);
+  if (native_)
+  {
+    const double when = std::max(due, lastScheduled_);
+    out_.schedule_message(int64_t(when), bytes, size);
+    lastScheduled_ = when;
+  }
+  else
+  {
+    out_.send_message(bytes, size);
+  }
+
+  stats_.events++;
+  stats_.max_lateness = std::max(stats_.max_lateness, lateness);
+  latenessSum_ += lateness;
+}
+
+RTMIDI17_INLINE
+void player::silence(double when)
+{
+  const int64_t now = out_.get_current_time();
+  for (int chan = 0; chan < 16; chan++)
+  {
+    const unsigned char m[3]{uint8_t(0xB0 | chan), 123, 0};
+    send(when, now, m, 3);
+  }
+}
+
+RTMIDI17_INLINE
+void player::chase(double songTime, double when)
+{
+  int program[16];
+  int bend[16];
+  int controls[16][120];
+  std::fill_n(program, 16, -1);
+  std::fill_n(bend, 16, -1);
+  std::fill_n(&controls[0][0], 16 * 120, -1);
+
+  for (std::size_t i = 0, n = first_event(songTime); i < n; i++)
+  {
+    const auto& b = events_[i].bytes;
+    if (b.size() < 2)
+      continue;
+
+    const int chan = b[0] & 0x0F;
+    switch (message_type(b[0] & 0xF0))
+    {
+      case message_type::PROGRAM_CHANGE:
+        program[chan] = b[1];
+        break;
+      case message_type::CONTROL_CHANGE:
+        // Channel mode messages (120 and above) are not state.
+        if (b.size() >= 3 && b[1] < 120)
+          controls[chan][b[1]] = b[2];
+        break;
+      case message_type::PITCH_BEND:
+        if (b.size() >= 3)
+          bend[chan] = b[1] | (b[2] << 7);
+        break;
+      default:
+        break;
+    }
+  }
+
+  const int64_t now = out_.get_current_time();
+  for (int chan = 0; chan < 16; chan++)
+  {
+    // Bank selects come before the program change they apply to.
+    for (int cc : {0, 32})
+    {
+      if (controls[chan][cc] >= 0)
+      {
+        const unsigned char m[3]{uint8_t(0xB0 | chan), uint8_t(cc), uint8_t(controls[chan][cc])};
+        send(when, now, m, 3);
+      }
+    }
+    if (program[chan] >= 0)
+    {
+      const unsigned char m[2]{uint8_t(0xC0 | chan), uint8_t(program[chan])};
+      send(when, now, m, 2);
+    }
+    for (int cc = 1; cc < 120; cc++)
+    {
+      if (cc != 32 && controls[chan][cc] >= 0)
+      {
+        const unsigned char m[3]{uint8_t(0xB0 | chan), uint8_t(cc), uint8_t(controls[chan][cc])};
+        send(when, now, m, 3);
+      }
+    }
+    if (bend[chan] >= 0)
+    {
+      const unsigned char m[3]{
+          uint8_t(0xE0 | chan), uint8_t(bend[chan] & 0x7F), uint8_t(bend[chan] >> 7)};
+      send(when, now, m, 3);
+    }
+  }
+}
+
+RTMIDI17_INLINE
+void player::halt(int64_t now)
+{
+  anchorSong_ = song_time(now);
+  playing_ = false;
+  silence(std::max(double(now), lastScheduled_));
+}
+
+RTMIDI17_INLINE
+void player::run()
+{
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (running_)
+  {
+    if (!playing_)
+    {
+      cv_.wait(lock);
+      continue;
+    }
+
+    const int64_t now = out_.get_current_time();
+    const double horizon = native_ ? double(now + lookahead_) : double(now);
+
+    // Clock time of the next thing to do once everything up to the
+    // horizon is sent.
+    double next{};
+    while (playing_)
+    {
+      const bool atLoopEnd
+          = loop_ && (index_ == events_.size() || events_[index_].time >= loopEnd_);
+      if (atLoopEnd)
+      {
+        next = clock_time(loopEnd_);
+        if (next > horizon)
+          break;
+
+        // The loop restarts exactly at its end, so that no drift accumulates.
+        silence(next);
+        wrap_ = loopEnd_ - loopStart_;
+        anchorSong_ = loopStart_;
+        anchorClock_ = next;
+        index_ = first_event(loopStart_);
+        continue;
+      }
+
+      if (index_ == events_.size())
+      {
+        next = clock_time(length_);
+        if (next > now)
+          break;
+
+        anchorSong_ = length_;
+        playing_ = false;
+        break;
+      }
+
+      const auto& e = events_[index_];
+      next = clock_time(e.time);
+      if (next > horizon)
+        break;
+
+      send(next, now, e.bytes.data(), e.bytes.size());
+      index_++;
+    }
+
+    if (!playing_)
+      continue;
+
+    // With native scheduling, wake up twice per lookahead to refill.
+    if (native_)
+    {
+      cv_.wait_for(lock, std::chrono::microseconds(lookahead_ / 2));
+      continue;
+    }
+
+    // Otherwise sleep until shortly before the next event, then spin for
+    // the rest of the way. The sleep is bounded in case the clock of the
+    // back-end drifts from the system clock.
+    const int64_t remaining = int64_t(next) - out_.get_current_time();
+    if (remaining > spin_)
+    {
+      const int64_t wait = std::min(remaining - spin_, int64_t(100000));
+      cv_.wait_for(lock, std::chrono::microseconds(wait));
+    }
+    else
+    {
+      lock.unlock();
+      while (out_.get_current_time() < int64_t(next))
+        ;
+      lock.lock();
+    }
+  }
+}
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <rtmidi17/reader.hpp>
+#include <rtmidi17/rtmidi17.hpp>
+#include <rtmidi17/tempo_map.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rtmidi
+{
+//! Timing statistics of a player.
+//! The lateness is the delay between the time at which an event was due
+//! and the time at which it was handed to the midi_out, in microseconds.
+struct player_stats
+{
+  uint64_t events{};      //!< Number of events sent or scheduled
+  double mean_lateness{}; //!< Mean lateness
+  double max_lateness{};  //!< Maximum lateness
+};
+
+/**********************************************************************/
+/*! \class player
+    \brief Plays a MIDI file on a midi_out from a dedicated thread.
+
+    The song must have been parsed with absolute ticks (reader{true}).
+    Its tempo changes are followed, and can be scaled as a whole.
+
+    Event times are computed from an anchor on the clock of the
+    midi_out, so that the latency of the thread does not accumulate.
+    When the back-end schedules output natively (see
+    midi_out::has_native_scheduling()), events are scheduled ahead of
+    time, up to the lookahead, and the thread only wakes up twice per
+    lookahead. Otherwise the thread sleeps until shortly before each
+    event and busy-waits until it is due.
+
+    Pausing, seeking and looping send All Notes Off on every channel.
+    Seeking also restores the last program change, controllers and
+    pitch bend of every channel before the new position.
+
+    Scheduled events cannot be recalled: changes made while playing take
+    effect after the events already scheduled, i.e. up to one lookahead
+    later.
+
+    The midi_out must not be used by other threads while the player
+    exists.
+*/
+/**********************************************************************/
+class RTMIDI17_EXPORT player
+{
+public:
+  player(midi_out& out, const reader& song);
+  ~player();
+
+  player(const player&) = delete;
+  player(player&&) = delete;
+  player& operator=(const player&) = delete;
+  player& operator=(player&&) = delete;
+
+  //! Plays from the current position, or from the beginning if the end
+  //! of the song was reached.
+  void play();
+
+  //! Stops playing. The position is kept.
+  void pause();
+
+  //! Stops playing and goes back to the beginning of the song.
+  void stop();
+
+  //! Goes to the given position, in quarter notes.
+  void seek(double quarters);
+
+  //! Current position, in quarter notes.
+  double get_position() const;
+
+  //! Length of the song, in quarter notes.
+  double get_length() const noexcept;
+
+  //! Plays the part of the song between start and end, in quarter notes,
+  //! over and over. An end before the start means the end of the song.
+  void set_loop(bool enable, double start = 0., double end = -1.);
+
+  //! Multiplies the tempo of the song by the given factor.
+  void set_tempo_scale(double scale);
+
+  double get_tempo_scale() const noexcept;
+
+  //! Current tempo, tempo scale included, in quarter notes per minute.
+  double get_tempo() const;
+
+  //! How far ahead events are scheduled on back-ends with native
+  //! scheduling. Defaults to 20 milliseconds.
+  void set_lookahead(std::chrono::microseconds lookahead);
+
+  //! Time before each event during which the thread busy-waits instead
+  //! of sleeping, on back-ends without native scheduling. Defaults to
+  //! 200 microseconds.
+  void set_spin_time(std::chrono::microseconds spin);
+
+  bool is_playing() const noexcept;
+
+  player_stats get_stats() const;
+  void reset_stats();
+
+private:
+  struct event
+  {
+    double time{}; // microseconds, at the original tempo
+    midi_bytes bytes;
+  };
+
+  void run();
+
+  // All the following require mutex_ to be held.
+  double song_time(int64_t now) const noexcept;
+  double clock_time(double songTime) const noexcept;
+  std::size_t first_event(double songTime) const noexcept;
+  double start_time() const;
+  void send(double due, int64_t now, const unsigned char* bytes, size_t size);
+  void silence(double when);
+  void chase(double songTime, double when);
+  void halt(int64_t now);
+
+  midi_out& out_;
+  const tempo_map tempo_;
+  std::vector<event> events_;
+  double length_{};
+
+  std::thread thread_;
+  std::atomic_bool running_{true};
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::atomic_bool playing_{};
+
+  // The song time anchorSong_ is played at the clock time anchorClock_.
+  double anchorSong_{};
+  double anchorClock_{};
+  // Length of the loop that was just restarted, while the anchor is
+  // still ahead of the clock.
+  double wrap_{};
+  std::size_t index_{};
+
+  bool loop_{};
+  double loopStart_{};
+  double loopEnd_{};
+  std::atomic<double> scale_{1.};
+  int64_t lookahead_{20000};
+  int64_t spin_{200};
+  double lastScheduled_{};
+  bool native_{};
+
+  player_stats stats_{};
+  double latenessSum_{};
+};
+}
+
+#if defined(RTMIDI17_HEADER_ONLY)
+#  include <rtmidi17/player.cpp>
+#endif
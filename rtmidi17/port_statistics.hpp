@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+
+namespace rtmidi
+{
+/**********************************************************************/
+/*! \class latency_histogram
+    \brief Distribution of durations in nanoseconds, with log-linear
+    buckets: each power of two is split in eight buckets, so the
+    relative resolution is about 12% at any scale, from nanoseconds to
+    an hour.
+*/
+/**********************************************************************/
+struct latency_histogram
+{
+  static constexpr int sub_bucket_bits = 3;
+  static constexpr int sub_buckets = 1 << sub_bucket_bits;
+  static constexpr int bucket_count = 40 * sub_buckets;
+
+  uint64_t counts[bucket_count]{};
+
+  //! Smallest duration counted in a bucket.
+  static constexpr uint64_t lower_bound(int bucket) noexcept
+  {
+    if (bucket < sub_buckets)
+      return uint64_t(bucket);
+    const int group = bucket >> sub_bucket_bits;
+    const int sub = bucket & (sub_buckets - 1);
+    return uint64_t(sub_buckets + sub) << (group - 1);
+  }
+
+  uint64_t count() const noexcept
+  {
+    uint64_t n = 0;
+    for (auto c : counts)
+      n += c;
+    return n;
+  }
+
+  //! Duration below which a fraction of the values fall, e.g. 0.99 for
+  //! the 99th percentile. Zero if the histogram is empty.
+  uint64_t percentile(double fraction) const noexcept
+  {
+    const uint64_t total = count();
+    if (total == 0)
+      return 0;
+
+    const auto rank = uint64_t(fraction * double(total - 1));
+    uint64_t seen = 0;
+    for (int i = 0; i < bucket_count; i++)
+    {
+      seen += counts[i];
+      if (seen > rank)
+        return i + 1 < bucket_count ? lower_bound(i + 1) - 1 : lower_bound(i);
+    }
+    return lower_bound(bucket_count - 1);
+  }
+};
+
+/**********************************************************************/
+/*! \class port_statistics
+    \brief A snapshot of the counters of a midi_in or a midi_out: see
+    midi_in::get_statistics() and midi_out::get_statistics().
+
+    Counters only grow: rates are computed from two snapshots, with
+    their times. Everything stays at zero when the library is built with
+    RTMIDI17_NO_STATISTICS.
+*/
+/**********************************************************************/
+struct port_statistics
+{
+  //! When the snapshot was taken, in microseconds on the steady clock
+  int64_t time{};
+
+  //! Messages delivered by an input, or sent by an output
+  uint64_t messages{};
+  uint64_t bytes{};
+
+  //! Messages lost because a queue or a buffer was full, or because a
+  //! sysex exceeded the limits.
+  uint64_t dropped{};
+
+  //! Events the back-end could not decode or send
+  uint64_t errors{};
+
+  //! Messages waiting in the queue of an input without callback
+  uint64_t queue_depth{};
+
+  //! Duration of the callback of an input, or of the sending of a
+  //! message by an output.
+  latency_histogram processing;
+
+  //! For inputs whose back-end timestamps the messages: delay between
+  //! their reception by the driver and the callback or the queue.
+  latency_histogram delay;
+};
+}
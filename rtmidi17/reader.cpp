@@ -29,6 +29,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <algorithm>
 #include <iostream>
 #include <rtmidi17/message.hpp>
+#include <rtmidi17/trace.hpp>
 
 // File Parsing Validation Todo:
 // ==============================
@@ -337,6 +338,7 @@ void reader::parse_impl(const std::vector<uint8_t>& buffer)
   if (headerId != 'MThd' || headerLength != 6)
   {
     std::cerr << "Bad .mid file - couldn't parse header" << std::endl;
+    tracks.clear();
     return;
   }
 
@@ -353,6 +355,7 @@ void reader::parse_impl(const std::vector<uint8_t>& buffer)
     // int fps = (timeDivision >> 16) & 0x7f;
     // int ticksPerFrame = timeDivision & 0xff;
     // given beats per second, timeDivision should be derivable.
+    tracks.clear();
     return;
   }
 
@@ -361,13 +364,19 @@ void reader::parse_impl(const std::vector<uint8_t>& buffer)
 
   for (int i = 0; i < trackCount; ++i)
   {
-    midi_track track;
+    RTMIDI17_TRACE_SCOPE("reader::parse_track");
+    // Tracks of a previous file are reused with their memory.
+    if (std::size_t(i) == tracks.size())
+      tracks.emplace_back();
+    auto& track = tracks[i];
+    track.clear();
 
     headerId = read_uint32_be(dataPtr);
     headerLength = read_uint32_be(dataPtr);
 
     if (headerId != 'MTrk')
     {
+      tracks.resize(i);
       throw std::runtime_error("Bad .mid file - couldn't find track header");
     }
 
@@ -399,16 +408,15 @@ void reader::parse_impl(const std::vector<uint8_t>& buffer)
           runningEvent = message_type(ev.m.bytes[0]);
         }
 
-        track.push_back(ev);
+        track.push_back(std::move(ev));
       }
       catch (const std::runtime_error& e)
       {
         std::cerr << e.what() << "\n";
       }
     }
-
-    tracks.push_back(track);
   }
+  tracks.resize(trackCount);
 }
 
 // In ticks
@@ -431,7 +439,7 @@ double reader::get_end_time()
 RTMIDI17_INLINE
 void reader::parse(const std::vector<uint8_t>& buffer)
 {
-  tracks.clear();
+  RTMIDI17_TRACE_SCOPE("reader::parse");
   parse_impl(buffer);
 }
 
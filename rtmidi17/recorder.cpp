@@ -0,0 +1,338 @@
+#if !defined(RTMIDI17_HEADER_ONLY)
+#  include <rtmidi17/recorder.hpp>
+#endif
+#include <rtmidi17/writer.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+
+namespace rtmidi
+{
+namespace util
+{
+//! Microseconds on the steady clock
+inline int64_t steady_now() noexcept
+{
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+}
+
+RTMIDI17_INLINE
+recorder::recorder(std::string path, int ticksPerBeat, double bpm)
+    : path_{std::move(path)}
+    , ticksPerBeat_{std::clamp(ticksPerBeat, 1, 0x7FFF)}
+    , bpm_{bpm > 0. ? bpm : 120.}
+{
+}
+
+RTMIDI17_INLINE
+recorder::~recorder()
+{
+  try
+  {
+    stop();
+  }
+  catch (...)
+  {
+  }
+
+  for (auto& t : tracks_)
+    t->input->cancel_callback();
+}
+
+RTMIDI17_INLINE
+int recorder::add_input(midi_in& in, std::string_view trackName, std::size_t bufferSize)
+{
+  if (recording_)
+    throw invalid_use_error{"recorder::add_input: cannot add an input while recording"};
+
+  auto& t = *tracks_.emplace_back(std::make_unique<track>());
+  t.input = &in;
+  t.name = trackName;
+  t.ring = std::make_unique<ring_buffer>(bufferSize);
+
+  in.set_callback([this, &t](const message& m) {
+    if (!recording_.load(std::memory_order_relaxed))
+      return;
+
+    const record_header header{
+        m.absolute_time != 0 ? m.absolute_time : util::steady_now(), uint32_t(m.bytes.size())};
+    if (!t.ring->write(&header, sizeof(header), m.bytes.data(), m.bytes.size()))
+      t.dropped.fetch_add(1, std::memory_order_relaxed);
+  });
+
+  return int(tracks_.size() - 1);
+}
+
+RTMIDI17_INLINE
+void recorder::set_quantize(double quarters)
+{
+  grid_ = std::max(int64_t(0), int64_t(std::llround(quarters * ticksPerBeat_)));
+}
+
+RTMIDI17_INLINE
+void recorder::start()
+{
+  start(util::steady_now());
+}
+
+RTMIDI17_INLINE
+void recorder::start(int64_t origin)
+{
+  if (recording_)
+    return;
+
+  for (auto& t : tracks_)
+  {
+    t->spill.reset(std::tmpfile());
+    if (!t->spill)
+      throw system_error{"recorder::start: cannot create a temporary file"};
+    t->length = 0;
+    t->lastTick = 0;
+    t->pending.clear();
+    t->sysex = false;
+    t->sysexTick = 0;
+    std::fill_n(&t->shift[0][0], 16 * 128, 0);
+    t->events = 0;
+    t->dropped = 0;
+    t->skipped = 0;
+
+    // Every track starts with its name.
+    t->encoded = {0x00, 0xFF, 0x03};
+    util::write_variable_length(uint32_t(t->name.size()), t->encoded);
+    t->encoded.insert(t->encoded.end(), t->name.begin(), t->name.end());
+  }
+
+  origin_ = origin;
+  running_ = true;
+  thread_ = std::thread{[this] { run(); }};
+  recording_ = true;
+}
+
+RTMIDI17_INLINE
+void recorder::stop()
+{
+  if (!recording_)
+    return;
+
+  recording_ = false;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    running_ = false;
+  }
+  cv_.notify_one();
+  thread_.join();
+
+  for (auto& t : tracks_)
+  {
+    drain(*t);
+    flush(*t, std::numeric_limits<int64_t>::max());
+    spill(*t);
+  }
+  write_file();
+
+  for (auto& t : tracks_)
+    t->spill.reset();
+}
+
+RTMIDI17_INLINE
+bool recorder::is_recording() const noexcept
+{
+  return recording_;
+}
+
+RTMIDI17_INLINE
+recorder_stats recorder::get_stats(int track) const
+{
+  const auto& t = *tracks_.at(std::size_t(track));
+  return {t.events, t.dropped, t.skipped};
+}
+
+RTMIDI17_INLINE
+void recorder::run()
+{
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (running_)
+  {
+    lock.unlock();
+    for (auto& t : tracks_)
+    {
+      drain(*t);
+      if (t->encoded.size() >= 65536)
+        spill(*t);
+    }
+    lock.lock();
+
+    cv_.wait_for(lock, std::chrono::milliseconds(10), [this] { return !running_; });
+  }
+}
+
+RTMIDI17_INLINE
+void recorder::drain(track& t)
+{
+  // The bytes of a message are written along with its header.
+  record_header header;
+  while (t.ring->read_space() >= sizeof(header))
+  {
+    t.ring->read(&header, sizeof(header));
+    buffer_.resize(header.size);
+    t.ring->read(buffer_.data(), header.size);
+    encode(t, header.time, buffer_.data(), header.size);
+  }
+}
+
+RTMIDI17_INLINE
+void recorder::encode(track& t, int64_t time, const uint8_t* bytes, uint32_t size)
+{
+  // Only channel messages and sysex can be stored in a file. Sysex
+  // delivered in chunks (see sysex_limits::chunk_size) are stored as a
+  // first packet without F7, then continuation packets.
+  const bool continuation = t.sysex && size > 0 && (bytes[0] < 0x80 || bytes[0] == 0xF7);
+  if (size == 0 || (!continuation && (bytes[0] < 0x80 || bytes[0] > 0xF0)))
+  {
+    t.skipped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  const double ticksPerMicrosecond = ticksPerBeat_ * bpm_ / 60e6;
+  int64_t tick = std::llround((time - origin_) * ticksPerMicrosecond);
+  tick = std::max(tick, int64_t(0));
+
+  const int64_t grid = grid_;
+  const int64_t received = tick;
+  const auto type = message_type(bytes[0] & 0xF0);
+  if (grid > 0 && size >= 3 && (type == message_type::NOTE_ON || type == message_type::NOTE_OFF))
+  {
+    auto& shift = t.shift[bytes[0] & 0x0F][bytes[1] & 0x7F];
+    if (type == message_type::NOTE_ON && bytes[2] != 0)
+    {
+      const int64_t quantized = std::llround(double(tick) / grid) * grid;
+      shift = quantized - tick;
+    }
+    tick += shift;
+  }
+
+  if (bytes[0] == 0xF0 || continuation)
+  {
+    t.sysex = bytes[size - 1] != 0xF7;
+    t.sysexTick = tick;
+  }
+  else
+  {
+    // Quantized notes are not moved before the last sysex packet.
+    tick = std::max(tick, t.sysexTick);
+  }
+
+  if (grid == 0 && t.pending.empty())
+  {
+    write_event(t, tick, bytes, size);
+    return;
+  }
+
+  // Quantization moves notes by at most half of the grid, so the events
+  // received later cannot go before received - grid / 2: the ones before
+  // that are in their final order.
+  const auto pos = std::upper_bound(
+      t.pending.begin(), t.pending.end(), tick,
+      [](int64_t value, const pending_event& e) { return value < e.tick; });
+  t.pending.insert(pos, {tick, {bytes, bytes + size}});
+  flush(t, received - grid / 2);
+}
+
+RTMIDI17_INLINE
+void recorder::flush(track& t, int64_t before)
+{
+  const auto end = std::find_if(t.pending.begin(), t.pending.end(), [=](const pending_event& e) {
+    return e.tick >= before;
+  });
+  for (auto it = t.pending.begin(); it != end; ++it)
+    write_event(t, it->tick, it->bytes.data(), it->bytes.size());
+  t.pending.erase(t.pending.begin(), end);
+}
+
+RTMIDI17_INLINE
+void recorder::write_event(track& t, int64_t tick, const uint8_t* bytes, std::size_t size)
+{
+  // Events must be in order in a track, which only inputs whose times go
+  // backwards, or a grid made finer while recording, can still break.
+  tick = std::max(tick, t.lastTick);
+  util::write_variable_length(uint32_t(tick - t.lastTick), t.encoded);
+  t.lastTick = tick;
+
+  if (bytes[0] == 0xF0)
+  {
+    // Sysex are stored with their length, without the leading F0.
+    t.encoded.push_back(0xF0);
+    util::write_variable_length(uint32_t(size - 1), t.encoded);
+    t.encoded.insert(t.encoded.end(), bytes + 1, bytes + size);
+  }
+  else if (bytes[0] < 0x80 || bytes[0] == 0xF7)
+  {
+    // Continuation packets are escaped with F7, and keep all their bytes.
+    t.encoded.push_back(0xF7);
+    util::write_variable_length(uint32_t(size), t.encoded);
+    t.encoded.insert(t.encoded.end(), bytes, bytes + size);
+  }
+  else
+  {
+    t.encoded.insert(t.encoded.end(), bytes, bytes + size);
+  }
+  t.events.fetch_add(1, std::memory_order_relaxed);
+}
+
+RTMIDI17_INLINE
+void recorder::spill(track& t)
+{
+  if (t.encoded.empty())
+    return;
+
+  if (std::fwrite(t.encoded.data(), 1, t.encoded.size(), t.spill.get()) != t.encoded.size())
+    throw system_error{"recorder: error writing a temporary file"};
+  t.length += t.encoded.size();
+  t.encoded.clear();
+}
+
+RTMIDI17_INLINE
+void recorder::write_file()
+{
+  std::ofstream out{path_, std::ios::binary};
+  if (!out)
+    throw system_error{"recorder: cannot open " + path_};
+
+  const auto write_chunk_header = [&](const char* id, uint32_t size) {
+    out.write(id, 4);
+    util::write_uint32_be(out, size);
+  };
+  const uint8_t endOfTrack[]{0x00, 0xFF, 0x2F, 0x00};
+
+  write_chunk_header("MThd", 6);
+  util::write_uint16_be(out, 1);
+  util::write_uint16_be(out, uint16_t(tracks_.size() + 1));
+  util::write_uint16_be(out, uint16_t(ticksPerBeat_));
+
+  // The first track holds the tempo.
+  const auto mpqn = uint32_t(std::lround(60e6 / bpm_));
+  const uint8_t tempo[]{
+      0x00, 0xFF, 0x51, 0x03, uint8_t(mpqn >> 16), uint8_t(mpqn >> 8), uint8_t(mpqn)};
+  write_chunk_header("MTrk", sizeof(tempo) + sizeof(endOfTrack));
+  out.write(reinterpret_cast<const char*>(tempo), sizeof(tempo));
+  out.write(reinterpret_cast<const char*>(endOfTrack), sizeof(endOfTrack));
+
+  std::vector<char> copy(65536);
+  for (auto& t : tracks_)
+  {
+    write_chunk_header("MTrk", uint32_t(t->length + sizeof(endOfTrack)));
+    std::rewind(t->spill.get());
+    while (const auto n = std::fread(copy.data(), 1, copy.size(), t->spill.get()))
+      out.write(copy.data(), std::streamsize(n));
+    out.write(reinterpret_cast<const char*>(endOfTrack), sizeof(endOfTrack));
+  }
+
+  if (!out.flush())
+    throw system_error{"recorder: error writing " + path_};
+}
+}
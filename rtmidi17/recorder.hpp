@@ -0,0 +1,154 @@
+#pragma once
+#include <rtmidi17/detail/ring_buffer.hpp>
+#include <rtmidi17/rtmidi17.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rtmidi
+{
+//! Statistics of a track of a recorder.
+struct recorder_stats
+{
+  uint64_t events{};  //!< Number of events written to the track
+  uint64_t dropped{}; //!< Number of messages lost because the input buffer was full
+  uint64_t skipped{}; //!< Number of messages which cannot be stored in a MIDI file
+};
+
+/**********************************************************************/
+/*! \class recorder
+    \brief Records one or more midi_in to a standard MIDI file, with one
+    track per input.
+
+    The callback of each input only copies the message and its time to a
+    lock-free ring buffer: it never blocks nor allocates. A dedicated
+    thread converts the times to ticks on the grid given by the tempo and
+    the resolution of the file, quantizes the notes if requested, and
+    encodes the events to a temporary file per track as they come, so
+    that the memory used does not grow with the length of the recording.
+    stop() writes the final file.
+
+    Times are taken from message::absolute_time when the back-end
+    provides it, and from the steady clock otherwise: all the inputs
+    must use the same clock.
+
+    System real-time and system common messages, which cannot be stored
+    in a MIDI file, are skipped. Sysex received in chunks are stored as
+    packets, the continuation ones escaped with F7.
+*/
+/**********************************************************************/
+class RTMIDI17_EXPORT recorder
+{
+public:
+  //! Records to the given file, with the given resolution, in ticks per
+  //! quarter note, and tempo, in quarter notes per minute.
+  explicit recorder(std::string path, int ticksPerBeat = 480, double bpm = 120.);
+  ~recorder();
+
+  recorder(const recorder&) = delete;
+  recorder(recorder&&) = delete;
+  recorder& operator=(const recorder&) = delete;
+  recorder& operator=(recorder&&) = delete;
+
+  //! Records an input on a new track, and returns the index of the
+  //! track. The recorder replaces the callback of the input, and cancels
+  //! it when destroyed: the input must outlive the recorder. Inputs can
+  //! only be added while not recording.
+  int add_input(midi_in& in, std::string_view trackName, std::size_t bufferSize = 1 << 16);
+
+  //! Moves notes to the closest multiple of the given duration, in
+  //! quarter notes, earlier or later. Note offs are moved along with their
+  //! note on, so that the duration of the notes is kept. Events are held
+  //! back for half of the duration, to be written in order. Zero, the
+  //! default, disables quantization.
+  void set_quantize(double quarters);
+
+  //! Starts recording. Tick zero is the current time.
+  void start();
+
+  //! Starts recording. Tick zero is the given time, in microseconds on
+  //! the clock of the inputs.
+  void start(int64_t origin);
+
+  //! Stops recording and writes the file.
+  void stop();
+
+  bool is_recording() const noexcept;
+
+  recorder_stats get_stats(int track) const;
+
+private:
+  struct file_deleter
+  {
+    void operator()(std::FILE* f) const noexcept
+    {
+      std::fclose(f);
+    }
+  };
+
+  // What an input callback writes to the ring buffer before the bytes
+  struct record_header
+  {
+    int64_t time;
+    uint32_t size;
+  };
+
+  // An event whose position in the track is not known yet
+  struct pending_event
+  {
+    int64_t tick;
+    std::vector<uint8_t> bytes;
+  };
+
+  struct track
+  {
+    midi_in* input{};
+    std::string name;
+    std::unique_ptr<ring_buffer> ring;
+    std::unique_ptr<std::FILE, file_deleter> spill;
+    std::vector<uint8_t> encoded; // not yet written to the spill file
+    uint64_t length{};            // bytes written to the spill file
+    int64_t lastTick{};
+    std::vector<pending_event> pending; // sorted by tick
+    bool sysex{};                       // in a sysex received in chunks
+    int64_t sysexTick{};                // of the last sysex packet
+    int64_t shift[16][128]{};     // quantization of the sounding notes
+    std::atomic<uint64_t> dropped{};
+    std::atomic<uint64_t> events{};
+    std::atomic<uint64_t> skipped{};
+  };
+
+  void run();
+  void drain(track& t);
+  void encode(track& t, int64_t time, const uint8_t* bytes, uint32_t size);
+  void flush(track& t, int64_t before);
+  void write_event(track& t, int64_t tick, const uint8_t* bytes, std::size_t size);
+  void spill(track& t);
+  void write_file();
+
+  const std::string path_;
+  const int ticksPerBeat_{};
+  const double bpm_{};
+  std::vector<std::unique_ptr<track>> tracks_;
+  std::vector<uint8_t> buffer_;
+
+  std::atomic_bool recording_{};
+  int64_t origin_{};
+  std::atomic<int64_t> grid_{}; // in ticks
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool running_{};
+  std::thread thread_;
+};
+}
+
+#if defined(RTMIDI17_HEADER_ONLY)
+#  include <rtmidi17/recorder.cpp>
+#endif
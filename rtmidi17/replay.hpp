@@ -0,0 +1,262 @@
+#pragma once
+#include <rtmidi17/reader.hpp>
+#include <rtmidi17/rtmidi17.hpp>
+#include <rtmidi17/tempo_map.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace rtmidi
+{
+//! Playback settings of a replay file.
+struct replay_options
+{
+  //! Speed factor relative to the original timing.
+  //! Zero or less replays the file as fast as possible.
+  double speed{1.};
+
+  //! Start again from the beginning once the end of the file is reached.
+  //! Files with a zero duration are played only once.
+  bool loop{true};
+};
+
+//! Statistics of the current, or last, replay of a file.
+struct replay_stats
+{
+  uint64_t messages{};   //!< Number of messages delivered
+  uint64_t loops{};      //!< Number of complete passes over the file
+  double rate{};         //!< Achieved rate, in messages per second
+  double mean_error{};   //!< Mean lateness relative to the deadlines, in microseconds
+  double max_error{};    //!< Maximum lateness relative to the deadlines, in microseconds
+};
+
+/**********************************************************************/
+/*! \class replay_file
+    \brief A recording which the REPLAY API presents as an input port.
+
+    Two formats are supported: standard MIDI files, and capture logs.
+    Capture logs are text files with one message per line, made of a
+    time in microseconds followed by the bytes of the message in
+    hexadecimal. Empty lines and lines starting with '#' are ignored:
+
+    \code
+    # time (us)  bytes
+    0            90 3c 64
+    500000       80 3c 00
+    \endcode
+
+    A file is replayed by one input at a time, which its statistics
+    describe: opening it in a second input fails until the first one
+    closes it.
+*/
+/**********************************************************************/
+class replay_file
+{
+public:
+  struct event
+  {
+    int64_t time{}; //!< Microseconds since the start of the file
+    midi_bytes bytes;
+  };
+
+  replay_file(std::string_view path, replay_options options)
+      : name_{path}, options_{options}
+  {
+    std::ifstream file{name_, std::ios::binary};
+    if (!file)
+      throw invalid_parameter_error{"replay_file: cannot open " + name_};
+
+    const std::vector<uint8_t> data{std::istreambuf_iterator<char>{file}, {}};
+    if (data.size() >= 4 && std::equal(data.begin(), data.begin() + 4, "MThd"))
+      load_smf(data);
+    else
+      load_log(data);
+  }
+
+  const std::string& name() const noexcept
+  {
+    return name_;
+  }
+
+  const replay_options& options() const noexcept
+  {
+    return options_;
+  }
+
+  const std::vector<event>& events() const noexcept
+  {
+    return events_;
+  }
+
+  //! Duration of one pass: the time of the last event, or of the end of
+  //! the longest track for MIDI files.
+  int64_t duration() const noexcept
+  {
+    return duration_;
+  }
+
+  replay_stats stats() const
+  {
+    std::lock_guard<std::mutex> lock{statsMutex_};
+    replay_stats s;
+    s.messages = messages_;
+    s.loops = loops_;
+    if (elapsed_ > 0)
+      s.rate = messages_ * 1e6 / elapsed_;
+    if (messages_ > 0)
+      s.mean_error = double(errorSum_) / messages_;
+    s.max_error = double(errorMax_);
+    return s;
+  }
+
+  // Called by the input which opens and closes the file
+  bool acquire() noexcept
+  {
+    return !open_.exchange(true, std::memory_order_acquire);
+  }
+
+  void release() noexcept
+  {
+    open_.store(false, std::memory_order_release);
+  }
+
+  // Called by the replay thread
+  void reset_stats()
+  {
+    std::lock_guard<std::mutex> lock{statsMutex_};
+    messages_ = loops_ = 0;
+    elapsed_ = errorSum_ = errorMax_ = 0;
+  }
+
+  void record_message(int64_t elapsed, int64_t lateness)
+  {
+    std::lock_guard<std::mutex> lock{statsMutex_};
+    messages_++;
+    elapsed_ = elapsed;
+    errorSum_ += lateness;
+    errorMax_ = std::max(errorMax_, lateness);
+  }
+
+  void record_loop()
+  {
+    std::lock_guard<std::mutex> lock{statsMutex_};
+    loops_++;
+  }
+
+private:
+  void load_smf(const std::vector<uint8_t>& data)
+  {
+    reader r{true};
+    r.parse(data);
+
+    // Merge the tracks, then convert ticks to time following the tempo changes.
+    std::vector<track_event> merged;
+    for (const auto& track : r.tracks)
+      merged.insert(merged.end(), track.begin(), track.end());
+    std::stable_sort(merged.begin(), merged.end(), [](const auto& lhs, const auto& rhs) {
+      return lhs.tick < rhs.tick;
+    });
+
+    const tempo_map tempo{r};
+    for (const auto& e : merged)
+    {
+      if (e.m.bytes.empty() || e.m.is_meta_event())
+        continue;
+
+      events_.push_back({int64_t(tempo.time_at(e.tick)), e.m.bytes});
+    }
+    if (!merged.empty())
+      duration_ = int64_t(tempo.time_at(merged.back().tick));
+  }
+
+  void load_log(const std::vector<uint8_t>& data)
+  {
+    std::istringstream input{std::string{data.begin(), data.end()}};
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(input, line))
+    {
+      lineNumber++;
+      std::istringstream ls{line};
+      int64_t time{};
+      if (!(ls >> time))
+      {
+        const auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+          continue;
+        throw invalid_parameter_error{
+            "replay_file: " + name_ + ":" + std::to_string(lineNumber) + ": invalid line"};
+      }
+
+      event ev{time, {}};
+      unsigned int byte{};
+      while (ls >> std::hex >> byte)
+        ev.bytes.push_back(uint8_t(byte));
+      if (!ev.bytes.empty())
+        events_.push_back(std::move(ev));
+    }
+
+    std::stable_sort(events_.begin(), events_.end(), [](const auto& lhs, const auto& rhs) {
+      return lhs.time < rhs.time;
+    });
+    if (!events_.empty())
+      duration_ = events_.back().time;
+  }
+
+  std::string name_;
+  replay_options options_;
+  std::vector<event> events_;
+  int64_t duration_{};
+  std::atomic<bool> open_{};
+
+  mutable std::mutex statsMutex_;
+  uint64_t messages_{};
+  uint64_t loops_{};
+  int64_t elapsed_{};
+  int64_t errorSum_{};
+  int64_t errorMax_{};
+};
+
+//! The files which the REPLAY API presents as input ports, in order.
+struct replay_registry
+{
+  static replay_registry& instance()
+  {
+    static replay_registry registry;
+    return registry;
+  }
+
+  std::mutex mutex;
+  std::vector<std::shared_ptr<replay_file>> files;
+};
+
+//! Loads a standard MIDI file or a capture log, and adds it to the input
+//! ports of the REPLAY API. The returned object gives access to the
+//! replay statistics.
+inline std::shared_ptr<replay_file>
+add_replay_file(std::string_view path, replay_options options = {})
+{
+  auto file = std::make_shared<replay_file>(path, options);
+  auto& registry = replay_registry::instance();
+  std::lock_guard<std::mutex> lock{registry.mutex};
+  registry.files.push_back(file);
+  return file;
+}
+
+//! Removes a file from the input ports of the REPLAY API.
+//! Inputs which are currently replaying it are not affected.
+inline void remove_replay_file(const std::shared_ptr<replay_file>& file)
+{
+  auto& registry = replay_registry::instance();
+  std::lock_guard<std::mutex> lock{registry.mutex};
+  registry.files.erase(
+      std::remove(registry.files.begin(), registry.files.end(), file), registry.files.end());
+}
+}
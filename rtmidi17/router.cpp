@@ -0,0 +1,279 @@
+#if !defined(RTMIDI17_HEADER_ONLY)
+#  include <rtmidi17/router.hpp>
+#endif
+
+#include <algorithm>
+#include <thread>
+
+namespace rtmidi
+{
+RTMIDI17_INLINE
+router::router()
+{
+  plan_ = new plan;
+}
+
+RTMIDI17_INLINE
+router::~router()
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  for (auto& n : nodes_)
+    if (n.in)
+      n.in->cancel_callback();
+
+  publish(nullptr);
+}
+
+RTMIDI17_INLINE
+router::node_id router::add_input(midi_in& in)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto& s = *states_.emplace_back(std::make_unique<input_state>());
+  node n;
+  n.kind = node_kind::input;
+  n.in = &in;
+  const node_id id = add_node(std::move(n), &s);
+
+  in.set_callback([this, &s, id](const message& m) { route(s, id, m); });
+  return id;
+}
+
+RTMIDI17_INLINE
+router::node_id router::add_input()
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto& s = *states_.emplace_back(std::make_unique<input_state>());
+  node n;
+  n.kind = node_kind::input;
+  return add_node(std::move(n), &s);
+}
+
+RTMIDI17_INLINE
+router::node_id router::add_transform(transform t)
+{
+  if (!t)
+    throw invalid_parameter_error{"router::add_transform: empty transform"};
+
+  std::lock_guard<std::mutex> lock{mutex_};
+  node n;
+  n.kind = node_kind::transform;
+  n.fn = std::make_shared<const transform>(std::move(t));
+  return add_node(std::move(n));
+}
+
+RTMIDI17_INLINE
+router::node_id router::add_output(midi_out& out)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  node n;
+  n.kind = node_kind::output;
+  n.out = &out;
+  return add_node(std::move(n));
+}
+
+RTMIDI17_INLINE
+void router::connect(node_id from, node_id to)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto& source = checked(from);
+  const auto& target = checked(to);
+  if (source.kind == node_kind::output || target.kind == node_kind::input)
+    throw invalid_parameter_error{"router::connect: outputs cannot be sources nor inputs targets"};
+
+  if (std::find(source.targets.begin(), source.targets.end(), to) == source.targets.end())
+    source.targets.push_back(to);
+}
+
+RTMIDI17_INLINE
+void router::disconnect(node_id from, node_id to)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto& targets = checked(from).targets;
+  targets.erase(std::remove(targets.begin(), targets.end(), to), targets.end());
+}
+
+RTMIDI17_INLINE
+void router::remove(node_id id)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  // The midi_in is kept, for its callback to be cancelled with the router.
+  auto& n = checked(id);
+  node removed;
+  removed.in = n.in;
+  n = std::move(removed);
+
+  for (auto& other : nodes_)
+    other.targets.erase(
+        std::remove(other.targets.begin(), other.targets.end(), id), other.targets.end());
+}
+
+RTMIDI17_INLINE
+void router::commit()
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto p = std::make_unique<plan>();
+  p->inputs.resize(nodes_.size());
+
+  std::vector<bool> visiting(nodes_.size());
+  for (node_id id = 0; id < nodes_.size(); id++)
+  {
+    const auto& n = nodes_[id];
+    if (n.kind == node_kind::transform)
+    {
+      p->transforms.push_back(n.fn);
+    }
+    else if (n.kind == node_kind::input)
+    {
+      const auto first = uint32_t(p->steps.size());
+      compile(id, 0, visiting, *p);
+      p->inputs[id] = {first, uint32_t(p->steps.size())};
+    }
+  }
+
+  publish(std::move(p));
+}
+
+RTMIDI17_INLINE
+void router::route(node_id input, const message& m)
+{
+  const auto& table = *table_.load(std::memory_order_acquire);
+  if (input >= table.size || !table.states[input])
+    throw invalid_parameter_error{"router::route: not an input"};
+
+  route(*table.states[input], input, m);
+}
+
+RTMIDI17_INLINE
+router::node& router::checked(node_id id)
+{
+  if (id >= nodes_.size() || nodes_[id].kind == node_kind::none)
+    throw invalid_parameter_error{"router: no such node"};
+  return nodes_[id];
+}
+
+RTMIDI17_INLINE
+router::node_id router::add_node(node n, input_state* state)
+{
+  const auto id = node_id(nodes_.size());
+  nodes_.push_back(std::move(n));
+
+  // Inputs may be routing with the current table: it is copied rather
+  // than reallocated when it is full.
+  const state_table* current = table_.load(std::memory_order_relaxed);
+  if (!current || current->size <= id)
+  {
+    auto table = std::make_unique<state_table>();
+    table->size = std::max(std::size_t(16), current ? current->size * 2 : 0);
+    table->states = std::make_unique<input_state*[]>(table->size);
+    if (current)
+      std::copy_n(current->states.get(), current->size, table->states.get());
+    table_.store(table.get(), std::memory_order_release);
+    tables_.push_back(std::move(table));
+  }
+  tables_.back()->states[id] = state;
+  return id;
+}
+
+RTMIDI17_INLINE
+void router::compile(node_id id, uint32_t depth, std::vector<bool>& visiting, plan& p) const
+{
+  for (node_id target : nodes_[id].targets)
+  {
+    const auto& n = nodes_[target];
+    if (n.kind == node_kind::output)
+    {
+      p.steps.push_back({nullptr, n.out, depth, 1});
+      continue;
+    }
+
+    if (visiting[target])
+      throw invalid_use_error{"router::commit: the graph has a cycle"};
+    if (depth == max_depth)
+      throw invalid_use_error{"router::commit: a path has too many transforms"};
+
+    const auto index = p.steps.size();
+    p.steps.push_back({n.fn.get(), nullptr, depth, 0});
+    visiting[target] = true;
+    compile(target, depth + 1, visiting, p);
+    visiting[target] = false;
+    p.steps[index].skip = uint32_t(p.steps.size() - index);
+  }
+}
+
+RTMIDI17_INLINE
+void router::publish(std::unique_ptr<plan> p)
+{
+  std::unique_ptr<const plan> old{plan_.exchange(p.release())};
+
+  // Inputs which started routing before the new epoch may still use the
+  // old plan: wait for them to finish. Inputs which start afterwards
+  // necessarily see the new plan.
+  const uint64_t epoch = epoch_.fetch_add(1) + 1;
+  for (const auto& s : states_)
+  {
+    for (;;)
+    {
+      const uint64_t e = s->epoch.load();
+      if (e == 0 || e >= epoch)
+        break;
+      std::this_thread::yield();
+    }
+  }
+}
+
+RTMIDI17_INLINE
+void router::route(input_state& s, node_id input, const message& m)
+{
+  struct idle
+  {
+    input_state& s;
+    ~idle()
+    {
+      s.routing = false;
+      s.epoch.store(0, std::memory_order_release);
+    }
+  };
+
+  // Routing this input again from within would overwrite the scratch
+  // copies in use. Other inputs have their own.
+  if (s.routing)
+    return;
+
+  s.routing = true;
+  s.epoch.store(epoch_.load());
+  idle guard{s};
+
+  const plan* p = plan_.load();
+  if (!p || input >= p->inputs.size())
+    return;
+
+  // in[d] is the message given to the steps at depth d
+  const message* in[max_depth + 1];
+  in[0] = &m;
+
+  const auto [first, last] = p->inputs[input];
+  for (uint32_t i = first; i < last;)
+  {
+    const step& st = p->steps[i];
+    const message& source = *in[st.depth];
+    if (st.out)
+    {
+      st.out->send_message(source);
+      i++;
+      continue;
+    }
+
+    message& copy = s.scratch[st.depth];
+    copy = source;
+    if ((*st.fn)(copy))
+    {
+      in[st.depth + 1] = &copy;
+      i++;
+    }
+    else
+    {
+      i += st.skip;
+    }
+  }
+}
+}
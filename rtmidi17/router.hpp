@@ -0,0 +1,156 @@
+#pragma once
+#include <rtmidi17/rtmidi17.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace rtmidi
+{
+/**********************************************************************/
+/*! \class router
+    \brief Routes messages from inputs to outputs through a graph of
+    transforms.
+
+    Inputs, transforms and outputs are the nodes of a directed acyclic
+    graph. Changes to the graph are staged, and commit() compiles the
+    graph into a flat plan: for each input, the list of the transforms
+    and outputs reached from it, in depth-first order. A message is
+    routed by walking this list, without any lookup, lock or allocation.
+
+    The plan is published atomically: messages already being routed
+    finish with the previous plan, and commit() waits for them before
+    freeing it (read-copy-update). Input threads thus never wait for
+    changes to the graph, and after commit() returns, nodes which were
+    removed are no longer used.
+
+    A transform may modify the message it is given, which is a copy for
+    the nodes after it, or return false to drop it. A transform reached
+    through several paths is called once per path. An output reached
+    from inputs which call back on different threads must be usable
+    from several threads at once.
+*/
+/**********************************************************************/
+class RTMIDI17_EXPORT router
+{
+public:
+  using node_id = uint32_t;
+  using transform = std::function<bool(message&)>;
+
+  //! Maximum number of transforms on a path from an input to an output.
+  static constexpr int max_depth = 16;
+
+  router();
+  ~router();
+
+  router(const router&) = delete;
+  router(router&&) = delete;
+  router& operator=(const router&) = delete;
+  router& operator=(router&&) = delete;
+
+  //! Adds an input fed by the messages of a midi_in. The router replaces
+  //! the callback of the input, and cancels it when the router is
+  //! destroyed: the input must outlive the router.
+  node_id add_input(midi_in& in);
+
+  //! Adds an input fed by calling route().
+  node_id add_input();
+
+  node_id add_transform(transform t);
+
+  node_id add_output(midi_out& out);
+
+  //! Routes the messages leaving a node to another node.
+  void connect(node_id from, node_id to);
+
+  void disconnect(node_id from, node_id to);
+
+  //! Removes a node and all its connections, on commit(). The callback of
+  //! a removed midi_in stays set, since its thread may be running it, and
+  //! drops the messages until the router is destroyed.
+  void remove(node_id node);
+
+  //! Publishes the changes made to the graph since the last commit.
+  //! Throws if the graph has a cycle or a path longer than max_depth.
+  void commit();
+
+  //! Routes a message from an input. Messages of a given input must not
+  //! be routed from several threads at once. Messages given to an input
+  //! while it routes one, e.g. by a transform, are dropped.
+  void route(node_id input, const message& m);
+
+private:
+  enum class node_kind : uint8_t
+  {
+    none, // removed
+    input,
+    transform,
+    output
+  };
+
+  // The state of an input while it routes a message
+  struct input_state
+  {
+    std::atomic<uint64_t> epoch{}; // epoch at which routing started, or 0 if idle
+    bool routing{};                // only used by the thread routing the input
+    message scratch[max_depth];    // copies modified by the transforms
+  };
+
+  struct node
+  {
+    node_kind kind{};
+    midi_in* in{};
+    midi_out* out{};
+    std::shared_ptr<const transform> fn;
+    std::vector<node_id> targets;
+  };
+
+  // A transform or an output, reached at some depth from an input
+  struct step
+  {
+    const transform* fn{};
+    midi_out* out{};
+    uint32_t depth{}; // number of transforms before the step
+    uint32_t skip{};  // number of steps reached through this one, itself included
+  };
+
+  struct plan
+  {
+    std::vector<std::shared_ptr<const transform>> transforms;
+    std::vector<step> steps;
+
+    // For each node: the range of steps of the input, if it is one
+    std::vector<std::pair<uint32_t, uint32_t>> inputs;
+  };
+
+  // The states of the inputs, indexed by node. They are only freed with
+  // the router, and the table is copied when it grows, so that route()
+  // can find them without a lock.
+  struct state_table
+  {
+    std::size_t size{};
+    std::unique_ptr<input_state*[]> states;
+  };
+
+  node& checked(node_id id);
+  node_id add_node(node n, input_state* state = nullptr);
+  void compile(node_id id, uint32_t depth, std::vector<bool>& visiting, plan& p) const;
+  void publish(std::unique_ptr<plan> p);
+  void route(input_state& s, node_id input, const message& m);
+
+  std::mutex mutex_; // serializes changes to the graph
+  std::vector<node> nodes_;
+  std::vector<std::unique_ptr<input_state>> states_;
+  std::vector<std::unique_ptr<state_table>> tables_;
+  std::atomic<const state_table*> table_{};
+
+  std::atomic<const plan*> plan_{};
+  std::atomic<uint64_t> epoch_{1};
+};
+}
+
+#if defined(RTMIDI17_HEADER_ONLY)
+#  include <rtmidi17/router.cpp>
+#endif
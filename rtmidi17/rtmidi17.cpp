@@ -36,6 +36,10 @@
 #  include <rtmidi17/detail/winuwp.hpp>
 #endif
 
+#include <rtmidi17/detail/loopback.hpp>
+#include <rtmidi17/detail/replay.hpp>
+#include <rtmidi17/detail/simulated.hpp>
+
 #if defined(RTMIDI17_DUMMY)
 #  include <rtmidi17/detail/dummy.hpp>
 #endif
@@ -72,6 +76,12 @@ static constexpr auto available_backends = make_tl(
     ,
     winuwp_backend {}
 #endif
+    ,
+    loopback_backend {}
+    ,
+    replay_backend {}
+    ,
+    simulated_backend {}
 #if defined(RTMIDI17_DUMMY)
     ,
     dummy_backend {}
@@ -81,6 +91,16 @@ static constexpr auto available_backends = make_tl(
 // There should always be at least one back-end.
 static_assert(std::tuple_size_v<decltype(available_backends)> >= 1);
 
+//! Back-ends which are only used when selected explicitly, never by the
+//! search for an API with ports of midi_in() and midi_out(): their ports
+//! are not visible to other applications, replay files or follow a
+//! simulated clock.
+static constexpr bool explicit_only(rtmidi::API api) noexcept
+{
+  return api == rtmidi::API::LOOPBACK || api == rtmidi::API::REPLAY
+         || api == rtmidi::API::SIMULATED;
+}
+
 template <typename F>
 auto for_all_backends(F&& f)
 {
@@ -107,7 +127,12 @@ RTMIDI17_INLINE system_error::~system_error() = default;
 RTMIDI17_INLINE thread_error::~thread_error() = default;
 
 RTMIDI17_INLINE midi_in::~midi_in() = default;
-RTMIDI17_INLINE midi_out::~midi_out() = default;
+RTMIDI17_INLINE midi_out::~midi_out()
+{
+  // The inputs must stop forwarding before the back-end goes away.
+  if (rtapi_)
+    static_cast<midi_out_api*>(rtapi_.get())->remove_thru_routes();
+}
 
 [[nodiscard]] RTMIDI17_INLINE std::vector<rtmidi::API> available_apis() noexcept
 {
@@ -220,6 +245,36 @@ void midi_in::ignore_types(bool midiSysex, bool midiTime, bool midiSense)
   (static_cast<midi_in_api*>(rtapi_.get()))->ignore_types(midiSysex, midiTime, midiSense);
 }
 
+RTMIDI17_INLINE
+void midi_in::set_filter(const input_filter& filter)
+{
+  (static_cast<midi_in_api*>(rtapi_.get()))->set_filter(filter);
+}
+
+RTMIDI17_INLINE
+port_statistics midi_in::get_statistics() const noexcept
+{
+  return (static_cast<midi_in_api*>(rtapi_.get()))->get_statistics();
+}
+
+RTMIDI17_INLINE
+void midi_in::set_sysex_limits(const sysex_limits& limits)
+{
+  (static_cast<midi_in_api*>(rtapi_.get()))->set_sysex_limits(limits);
+}
+
+RTMIDI17_INLINE
+void midi_in::add_thru(midi_out& out, const input_filter& filter, thru_transform transform)
+{
+  (static_cast<midi_in_api*>(rtapi_.get()))->add_thru(*out.rtapi_, filter, std::move(transform));
+}
+
+RTMIDI17_INLINE
+void midi_in::remove_thru(midi_out& out)
+{
+  (static_cast<midi_in_api*>(rtapi_.get()))->remove_thru(*out.rtapi_);
+}
+
 RTMIDI17_INLINE
 message midi_in::get_message()
 {
@@ -253,6 +308,7 @@ void midi_out::open_virtual_port(std::string_view portName)
 RTMIDI17_INLINE
 void midi_out::close_port()
 {
+  (static_cast<midi_out_api*>(rtapi_.get()))->remove_thru_routes();
   rtapi_->close_port();
 }
 
@@ -289,7 +345,55 @@ void midi_out::send_message(const rtmidi::message& message)
 RTMIDI17_INLINE
 void midi_out::send_message(const unsigned char* message, size_t size)
 {
-  (static_cast<midi_out_api*>(rtapi_.get()))->send_message(message, size);
+  (static_cast<midi_out_api*>(rtapi_.get()))->send_counted(message, size);
+}
+
+RTMIDI17_INLINE
+void midi_out::schedule_message(int64_t timestamp, const unsigned char* message, size_t size)
+{
+  (static_cast<midi_out_api*>(rtapi_.get()))->schedule_counted(timestamp, message, size);
+}
+
+RTMIDI17_INLINE
+void midi_out::schedule_message(int64_t timestamp, const rtmidi::message& message)
+{
+  schedule_message(timestamp, message.bytes.data(), message.bytes.size());
+}
+
+RTMIDI17_INLINE
+void midi_out::send_messages(const rtmidi::message* messages, size_t count)
+{
+  (static_cast<midi_out_api*>(rtapi_.get()))->send_counted(messages, count);
+}
+
+RTMIDI17_INLINE
+void midi_out::send_messages(const std::vector<rtmidi::message>& messages)
+{
+  send_messages(messages.data(), messages.size());
+}
+
+RTMIDI17_INLINE
+uint64_t midi_out::get_dropped_count() const noexcept
+{
+  return (static_cast<midi_out_api*>(rtapi_.get()))->get_dropped_count();
+}
+
+RTMIDI17_INLINE
+port_statistics midi_out::get_statistics() const noexcept
+{
+  return (static_cast<midi_out_api*>(rtapi_.get()))->get_statistics();
+}
+
+RTMIDI17_INLINE
+int64_t midi_out::get_current_time() const noexcept
+{
+  return (static_cast<midi_out_api*>(rtapi_.get()))->get_current_time();
+}
+
+RTMIDI17_INLINE
+bool midi_out::has_native_scheduling() const noexcept
+{
+  return (static_cast<midi_out_api*>(rtapi_.get()))->has_native_scheduling();
 }
 
 RTMIDI17_INLINE
@@ -324,6 +428,9 @@ midi_in::midi_in(rtmidi::API api, std::string_view clientName, unsigned int queu
   // one with at least one port or we reach the end of the list.
   for (const auto& api : available_apis())
   {
+    if (explicit_only(api))
+      continue;
+
     rtapi_ = open_midi_in(api, clientName, queueSizeLimit);
     if (rtapi_ && rtapi_->get_port_count() != 0)
     {
@@ -370,6 +477,9 @@ midi_out::midi_out(rtmidi::API api, std::string_view clientName)
   // one with at least one port or we reach the end of the list.
   for (const auto& api : available_apis())
   {
+    if (explicit_only(api))
+      continue;
+
     rtapi_ = open_midi_out(api, clientName);
     if (rtapi_ && rtapi_->get_port_count() != 0)
     {
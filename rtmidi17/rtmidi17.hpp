@@ -61,7 +61,10 @@
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <rtmidi17/input_filter.hpp>
 #include <rtmidi17/message.hpp>
+#include <rtmidi17/port_statistics.hpp>
+#include <rtmidi17/sysex_limits.hpp>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -170,6 +173,9 @@ enum class API
   UNIX_JACK,   /*!< The JACK Low-Latency MIDI Server API. */
   WINDOWS_MM,  /*!< The Microsoft Multimedia MIDI API. */
   WINDOWS_UWP, /*!< The Microsoft WinRT MIDI API. */
+  LOOPBACK,    /*!< In-process virtual ports, only used when selected. */
+  REPLAY,      /*!< Replay of files as inputs, only used when selected. */
+  SIMULATED,   /*!< Virtual ports on a simulated clock, only used when selected. */
   DUMMY        /*!< A compilable but non-functional API. */
 };
 
@@ -205,6 +211,8 @@ private:
   std::unique_ptr<class observer_api> impl_;
 };
 
+class midi_out;
+
 /**********************************************************************/
 /*! \class midi_in
     \brief A realtime MIDI input class.
@@ -227,6 +235,9 @@ public:
   //! User callback function type definition.
   using message_callback = std::function<void(const message& message)>;
 
+  //! Changes a message forwarded by thru, or returns false to drop it.
+  using thru_transform = std::function<bool(message&)>;
+
   //! Default constructor that allows an optional api, client name and queue
   //! size.
   /*!
@@ -346,6 +357,61 @@ public:
   */
   void ignore_types(bool midiSysex = true, bool midiTime = true, bool midiSense = true);
 
+  //! Specify which MIDI messages should be queued or ignored during input.
+  /*!
+    Besides the message types, the filter can select channels, ranges
+    of notes and controllers, and limit the rate of each type. The ALSA
+    and JACK back-ends, as well as the in-process ones, evaluate it as
+    soon as a message is received, before decoding or copying it; the
+    others only honor the sysex, timing and active sensing types, like
+    ignore_types(). ignore_types() changes the types of the current
+    filter.
+  */
+  void set_filter(const input_filter& filter);
+
+  //! A snapshot of the counters of this input.
+  /*!
+    Can be called from any thread at any time. The processing histogram
+    measures the duration of the callback; the delay histogram, when the
+    back-end provides the reception time of the messages, the time they
+    took to reach the callback or the queue.
+  */
+  port_statistics get_statistics() const noexcept;
+
+  //! Bound the reassembly of the sysex received in several parts.
+  /*!
+    The ALSA and JACK back-ends reassemble the sysex of each sender
+    separately, drop those which exceed the limits, and can deliver very
+    large dumps in chunks as they come.
+  */
+  void set_sysex_limits(const sysex_limits& limits);
+
+  //! Forward the messages received by this input to an output.
+  /*!
+    The messages are sent from the thread which receives them, as soon
+    as they arrive, before the filter of this input and its callback or
+    queue. With ALSA, when both ports are opened with open_port() and
+    all the messages are forwarded unchanged, the sequencer routes them
+    itself. With JACK, unchanged messages to an output of the same
+    client are queued from the process callback, and sent during the
+    same cycle when the output port is processed after the input one;
+    they are not counted in the statistics of the output. The input
+    thread forwards the messages of the other routes.
+
+    While routes target an output, its sends are serialized: it can be
+    used by other threads and by several inputs at once, provided that
+    they start sending to it after add_thru() returns.
+
+    Closing or destroying the output removes the routes to it. Adding
+    the same output again replaces its filter and transform.
+  */
+  void add_thru(
+      midi_out& out, const input_filter& filter = input_filter::all(),
+      thru_transform transform = {});
+
+  //! Stop forwarding messages to an output.
+  void remove_thru(midi_out& out);
+
   //! Fill the user-provided vector with the data bytes for the next available
   //! MIDI message in the input queue and return the event delta-time in
   //! seconds.
@@ -485,6 +551,48 @@ public:
   */
   void send_message(const unsigned char* message, size_t size);
 
+  //! Schedule a single message to be sent at a given time.
+  /*!
+      The timestamp is an absolute time in microseconds, on the clock
+      returned by get_current_time(). Messages should be scheduled in
+      non-decreasing time order. Back-ends without native scheduling
+      (see has_native_scheduling()) send the message immediately.
+
+      \param timestamp Time at which the message must be sent
+      \param message   A pointer to the MIDI message as raw bytes
+      \param size      Length of the MIDI message in bytes
+  */
+  void schedule_message(int64_t timestamp, const unsigned char* message, size_t size);
+
+  void schedule_message(int64_t timestamp, const rtmidi::message& message);
+
+  //! Immediately send a batch of messages out an open MIDI output port.
+  /*!
+      With JACK the whole batch is queued atomically: either all the
+      messages are queued, or none of them is and they are all counted
+      as dropped. Queued messages are sent in order, starting in the
+      next cycle; those that do not fit in its buffer go in the
+      following ones.
+  */
+  void send_messages(const rtmidi::message* messages, size_t count);
+
+  void send_messages(const std::vector<rtmidi::message>& messages);
+
+  //! Returns the number of messages dropped by the back-end, for instance
+  //! because its output buffer was full.
+  uint64_t get_dropped_count() const noexcept;
+
+  //! A snapshot of the counters of this output, including
+  //! get_dropped_count(). Can be called from any thread at any time.
+  port_statistics get_statistics() const noexcept;
+
+  //! Returns the current time of the back-end clock, in microseconds.
+  int64_t get_current_time() const noexcept;
+
+  //! Returns true if schedule_message delivers messages at their
+  //! timestamp (ALSA, JACK and SIMULATED), false if it sends them immediately.
+  bool has_native_scheduling() const noexcept;
+
   //! Set an error callback function to be invoked when an error has occured.
   /*!
     The callback function will be called whenever an error has occured. It is
@@ -497,6 +605,7 @@ public:
   void set_port_name(std::string_view portName);
 
 private:
+  friend class midi_in;
   std::unique_ptr<class midi_out_api> rtapi_;
 };
 }
@@ -0,0 +1,333 @@
+#if !defined(RTMIDI17_HEADER_ONLY)
+#  include <rtmidi17/scheduler.hpp>
+#endif
+
+#include <algorithm>
+#include <functional>
+
+namespace rtmidi
+{
+RTMIDI17_INLINE
+scheduler::scheduler(std::chrono::microseconds resolution)
+    : origin_{now()}, resolution_{std::max(int64_t(resolution.count()), int64_t(1))}
+{
+  std::fill_n(&wheel_[0][0], levels * slots, nil);
+  thread_ = std::thread{[this] { run(); }};
+}
+
+RTMIDI17_INLINE
+scheduler::~scheduler()
+{
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    running_ = false;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+RTMIDI17_INLINE
+int64_t scheduler::now() const noexcept
+{
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+RTMIDI17_INLINE
+scheduler::event_id
+scheduler::schedule(midi_out& out, int64_t time, const unsigned char* bytes, size_t size)
+{
+  const bool native = out.has_native_scheduling();
+
+  event_id id{};
+  bool notify{};
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    // With nothing pending, the idle ticks can be skipped at once.
+    if (count_ == 0)
+      current_ = std::max(current_, elapsed_ticks());
+
+    uint32_t n = free_;
+    if (n != nil)
+    {
+      free_ = nodes_[n].next;
+    }
+    else
+    {
+      n = uint32_t(nodes_.size());
+      nodes_.emplace_back();
+    }
+
+    auto& e = nodes_[n];
+    e.time = time;
+    e.tick = tick_of(native ? time - lookahead_ : time);
+    e.order = order_++;
+    e.out = &out;
+    e.native = native;
+    e.bytes.assign(bytes, bytes + size);
+    insert(n, current_ + 1);
+    count_++;
+
+    id = (uint64_t(e.generation) << 32) | n;
+    notify = std::max(e.tick, current_ + 1) < wake_;
+  }
+
+  if (notify)
+    cv_.notify_one();
+  return id;
+}
+
+RTMIDI17_INLINE
+scheduler::event_id scheduler::schedule(midi_out& out, int64_t time, const message& m)
+{
+  return schedule(out, time, m.bytes.data(), m.bytes.size());
+}
+
+RTMIDI17_INLINE
+bool scheduler::cancel(event_id id)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  const auto n = uint32_t(id);
+  if (n >= nodes_.size() || nodes_[n].bucket == nil || nodes_[n].generation != (id >> 32))
+    return false;
+
+  unlink(n);
+  release(n);
+  return true;
+}
+
+RTMIDI17_INLINE
+void scheduler::cancel(const midi_out& out)
+{
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    for (uint32_t n = 0; n < nodes_.size(); n++)
+    {
+      if (nodes_[n].bucket != nil && nodes_[n].out == &out)
+      {
+        unlink(n);
+        release(n);
+      }
+    }
+  }
+
+  // Wait for the events which were already fired to be sent.
+  std::lock_guard<std::mutex> sending{sendMutex_};
+}
+
+RTMIDI17_INLINE
+std::size_t scheduler::pending() const
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  return count_;
+}
+
+RTMIDI17_INLINE
+void scheduler::set_lookahead(std::chrono::microseconds lookahead)
+{
+  std::lock_guard<std::mutex> lock{mutex_};
+  lookahead_ = std::max(int64_t(lookahead.count()), int64_t(0));
+}
+
+RTMIDI17_INLINE
+uint64_t scheduler::tick_of(int64_t time) const noexcept
+{
+  if (time <= origin_)
+    return 0;
+  return uint64_t((time - origin_ + resolution_ - 1) / resolution_);
+}
+
+RTMIDI17_INLINE
+uint64_t scheduler::elapsed_ticks() const noexcept
+{
+  return uint64_t(std::max(now() - origin_, int64_t(0)) / resolution_);
+}
+
+RTMIDI17_INLINE
+uint64_t scheduler::next_tick() const noexcept
+{
+  if (count_ == 0)
+    return UINT64_MAX;
+
+  // The first non-empty slot of the first level, or the end of its turn,
+  // where the next level cascades.
+  for (uint64_t t = current_ + 1;; t++)
+  {
+    const auto slot = t & (slots - 1);
+    if (slot == 0 || wheel_[0][slot] != nil)
+      return t;
+  }
+}
+
+RTMIDI17_INLINE
+void scheduler::insert(uint32_t n, uint64_t earliest) noexcept
+{
+  auto& e = nodes_[n];
+  uint64_t tick = std::max(e.tick, earliest);
+
+  // The level is given by how far the event is; events beyond the range
+  // of the wheel are parked in the last slot of the last level to turn,
+  // and inserted again from there.
+  int level = 0;
+  const uint64_t range = uint64_t(1) << (bits * levels);
+  if (tick - current_ >= range)
+  {
+    level = levels - 1;
+    tick = current_ + range - 1;
+  }
+  else
+  {
+    while (tick - current_ >= (uint64_t(1) << (bits * (level + 1))))
+      level++;
+  }
+
+  e.bucket = uint32_t(level) * slots + uint32_t((tick >> (bits * level)) & (slots - 1));
+  uint32_t& head = (&wheel_[0][0])[e.bucket];
+  e.prev = nil;
+  e.next = head;
+  if (head != nil)
+    nodes_[head].prev = n;
+  head = n;
+}
+
+RTMIDI17_INLINE
+void scheduler::unlink(uint32_t n) noexcept
+{
+  auto& e = nodes_[n];
+  if (e.prev != nil)
+    nodes_[e.prev].next = e.next;
+  else
+    (&wheel_[0][0])[e.bucket] = e.next;
+  if (e.next != nil)
+    nodes_[e.next].prev = e.prev;
+}
+
+RTMIDI17_INLINE
+void scheduler::release(uint32_t n) noexcept
+{
+  auto& e = nodes_[n];
+  e.bucket = nil;
+  e.out = nullptr;
+  if (++e.generation == 0)
+    e.generation = 1;
+  e.next = free_;
+  free_ = n;
+  count_--;
+}
+
+RTMIDI17_INLINE
+void scheduler::advance(uint64_t target)
+{
+  while (current_ < target)
+  {
+    if (count_ == 0)
+    {
+      current_ = target;
+      return;
+    }
+
+    current_++;
+    const auto slot = uint32_t(current_ & (slots - 1));
+
+    // At the end of a turn, the next slot of the level above is spread
+    // over the level below, and so on.
+    if (slot == 0)
+    {
+      for (int level = 1; level < levels; level++)
+      {
+        const auto index = uint32_t((current_ >> (bits * level)) & (slots - 1));
+        uint32_t n = wheel_[level][index];
+        wheel_[level][index] = nil;
+        while (n != nil)
+        {
+          const uint32_t next = nodes_[n].next;
+          insert(n, current_);
+          n = next;
+        }
+        if (index != 0)
+          break;
+      }
+    }
+
+    uint32_t n = wheel_[0][slot];
+    wheel_[0][slot] = nil;
+    while (n != nil)
+    {
+      auto& e = nodes_[n];
+      const uint32_t next = e.next;
+      auto& f = batch_.emplace_back();
+      f.out = e.out;
+      f.time = e.time;
+      f.order = e.order;
+      f.native = e.native;
+      f.m.bytes = e.bytes;
+      release(n);
+      n = next;
+    }
+  }
+}
+
+RTMIDI17_INLINE
+void scheduler::dispatch()
+{
+  // Group the events by port, in time order.
+  std::sort(batch_.begin(), batch_.end(), [](const fired& lhs, const fired& rhs) {
+    if (lhs.out != rhs.out)
+      return std::less<midi_out*>{}(lhs.out, rhs.out);
+    if (lhs.time != rhs.time)
+      return lhs.time < rhs.time;
+    return lhs.order < rhs.order;
+  });
+
+  const int64_t t = now();
+  for (auto it = batch_.begin(); it != batch_.end();)
+  {
+    midi_out& out = *it->out;
+    const auto end
+        = std::find_if(it, batch_.end(), [&](const fired& f) { return f.out != &out; });
+    if (it->native)
+    {
+      const int64_t offset = out.get_current_time() - t;
+      for (; it != end; ++it)
+        out.schedule_message(it->time + offset, it->m);
+    }
+    else
+    {
+      messages_.clear();
+      for (; it != end; ++it)
+        messages_.push_back(std::move(it->m));
+      out.send_messages(messages_);
+    }
+  }
+  batch_.clear();
+}
+
+RTMIDI17_INLINE
+void scheduler::run()
+{
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (running_)
+  {
+    advance(elapsed_ticks());
+    if (!batch_.empty())
+    {
+      std::unique_lock<std::mutex> sending{sendMutex_};
+      lock.unlock();
+      dispatch();
+      sending.unlock();
+      lock.lock();
+      continue;
+    }
+
+    wake_ = next_tick();
+    if (wake_ == UINT64_MAX)
+      cv_.wait(lock);
+    else
+      cv_.wait_until(
+          lock, std::chrono::steady_clock::time_point{
+                    std::chrono::microseconds{origin_ + int64_t(wake_) * resolution_}});
+    wake_ = 0;
+  }
+}
+}
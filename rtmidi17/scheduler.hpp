@@ -0,0 +1,145 @@
+#pragma once
+#include <rtmidi17/rtmidi17.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rtmidi
+{
+/**********************************************************************/
+/*! \class scheduler
+    \brief Sends messages at given times on any number of midi_out,
+    from a single dispatch thread.
+
+    Pending events are kept in a hierarchical timing wheel: four levels
+    of 256 slots, each slot of a level spanning a whole turn of the
+    level below. Scheduling and cancelling an event take constant time
+    however many events are pending, and the dispatch thread only
+    touches the slots which expire.
+
+    Times are in microseconds on the clock returned by now(). Events are
+    fired at the first tick at or after their time, and all the events
+    of a tick for a given port are sent together with
+    midi_out::send_messages(). On ports with native scheduling (see
+    midi_out::has_native_scheduling()), events are instead handed to the
+    back-end one lookahead before their time, with their exact
+    timestamp: their timing then depends neither on the resolution nor
+    on the dispatch thread, but they can only be cancelled until then.
+
+    The events of a midi_out must be cancelled with cancel(const
+    midi_out&) before it is destroyed. A midi_out must not be used by
+    other threads while it has pending events.
+*/
+/**********************************************************************/
+class RTMIDI17_EXPORT scheduler
+{
+public:
+  //! Identifies a scheduled event. Zero is never a valid identifier.
+  using event_id = uint64_t;
+
+  //! Starts the dispatch thread. The resolution is the duration of a
+  //! tick of the wheel.
+  explicit scheduler(std::chrono::microseconds resolution = std::chrono::microseconds(1000));
+  ~scheduler();
+
+  scheduler(const scheduler&) = delete;
+  scheduler(scheduler&&) = delete;
+  scheduler& operator=(const scheduler&) = delete;
+  scheduler& operator=(scheduler&&) = delete;
+
+  //! Current time, in microseconds.
+  int64_t now() const noexcept;
+
+  //! Schedules a message to be sent on a port at the given time.
+  event_id schedule(midi_out& out, int64_t time, const unsigned char* bytes, size_t size);
+
+  event_id schedule(midi_out& out, int64_t time, const message& m);
+
+  //! Cancels a pending event. Returns false if it was already sent or
+  //! cancelled.
+  bool cancel(event_id id);
+
+  //! Cancels all the pending events of a port. When this returns, the
+  //! dispatch thread no longer uses the port.
+  void cancel(const midi_out& out);
+
+  //! Number of pending events.
+  std::size_t pending() const;
+
+  //! How long before their time events are handed to back-ends with
+  //! native scheduling. Defaults to 20 milliseconds; only applies to the
+  //! events scheduled afterwards.
+  void set_lookahead(std::chrono::microseconds lookahead);
+
+private:
+  static constexpr int levels = 4;
+  static constexpr int bits = 8;
+  static constexpr uint32_t slots = 1 << bits;
+  static constexpr uint32_t nil = UINT32_MAX;
+
+  struct node
+  {
+    int64_t time{};
+    uint64_t tick{};
+    uint64_t order{};
+    midi_out* out{};
+    bool native{};
+    uint32_t generation{1};
+    uint32_t bucket{nil}; // level * slots + slot, or nil when free
+    uint32_t prev{nil};
+    uint32_t next{nil};
+    midi_bytes bytes;
+  };
+
+  struct fired
+  {
+    midi_out* out{};
+    int64_t time{};
+    uint64_t order{};
+    bool native{};
+    message m;
+  };
+
+  void run();
+  uint64_t tick_of(int64_t time) const noexcept;
+  uint64_t elapsed_ticks() const noexcept;
+  uint64_t next_tick() const noexcept;
+  void insert(uint32_t n, uint64_t earliest) noexcept;
+  void unlink(uint32_t n) noexcept;
+  void release(uint32_t n) noexcept;
+  void advance(uint64_t target);
+  void dispatch();
+
+  const int64_t origin_{};
+  const int64_t resolution_{};
+
+  // Protected by mutex_
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<node> nodes_;
+  uint32_t free_{nil};
+  uint32_t wheel_[levels][slots];
+  std::size_t count_{};
+  uint64_t current_{}; // last processed tick
+  uint64_t wake_{};    // tick at which the dispatch thread wakes up
+  uint64_t order_{};
+  int64_t lookahead_{20000};
+
+  // Only accessed by the dispatch thread, which holds sendMutex_ while
+  // it sends.
+  std::mutex sendMutex_;
+  std::vector<fired> batch_;
+  std::vector<message> messages_;
+
+  std::atomic_bool running_{true};
+  std::thread thread_;
+};
+}
+
+#if defined(RTMIDI17_HEADER_ONLY)
+#  include <rtmidi17/scheduler.cpp>
+#endif
@@ -0,0 +1,128 @@
+#pragma once
+#include <rtmidi17/detail/loopback.hpp>
+
+#include <atomic>
+#include <queue>
+#include <vector>
+
+namespace rtmidi
+{
+/**********************************************************************/
+/*! \class simulated_clock
+    \brief The virtual clock which drives the SIMULATED API.
+
+    The SIMULATED API works like the LOOPBACK API, with its own set of
+    virtual ports, except that time only passes when advance() or
+    advance_to() is called. Messages given to midi_out::send_message are
+    delivered immediately and stamped with the current virtual time.
+    Messages given to midi_out::schedule_message are delivered, from the
+    thread which advances the clock, when the clock reaches their
+    timestamp, and carry this exact timestamp in message::absolute_time.
+
+    Times are in microseconds and start at zero.
+*/
+/**********************************************************************/
+class simulated_clock
+{
+public:
+  static simulated_clock& instance()
+  {
+    static simulated_clock clock;
+    return clock;
+  }
+
+  //! Current virtual time
+  int64_t now() const noexcept
+  {
+    return now_;
+  }
+
+  //! Advances the clock by the given duration. See advance_to().
+  void advance(int64_t duration)
+  {
+    advance_to(now() + duration);
+  }
+
+  //! Advances the clock to the given time, delivering the scheduled
+  //! messages which fall until then in order. Messages scheduled for the
+  //! same time are delivered in the order they were scheduled. Messages
+  //! scheduled by callbacks during the advance are delivered as well
+  //! if they fall within it.
+  void advance_to(int64_t time)
+  {
+    for (;;)
+    {
+      event e;
+      {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (events_.empty() || events_.top().time > time)
+          break;
+
+        e = events_.top();
+        events_.pop();
+        // Messages scheduled in the past are delivered now
+        e.time = std::max(e.time, now_.load());
+        now_ = e.time;
+      }
+
+      if (auto source = e.source.lock())
+        source->send(e.bytes.data(), e.bytes.size(), e.time);
+    }
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    now_ = std::max(now_.load(), time);
+  }
+
+  //! Sets the clock back to the given time, and drops all the scheduled messages.
+  void reset(int64_t time = 0)
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    events_ = {};
+    now_ = time;
+  }
+
+  //! Number of scheduled messages not delivered yet
+  std::size_t pending() const
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return events_.size();
+  }
+
+  // Used by the back-end
+  loopback_bus& bus() noexcept
+  {
+    return bus_;
+  }
+
+  void schedule(
+      const std::shared_ptr<loopback_source>& source, int64_t time, const unsigned char* bytes,
+      size_t size)
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    events_.push({time, order_++, source, std::vector<unsigned char>(bytes, bytes + size)});
+  }
+
+private:
+  struct event
+  {
+    int64_t time{};
+    uint64_t order{};
+    std::weak_ptr<loopback_source> source;
+    std::vector<unsigned char> bytes; // moved at each heap operation, by pointer
+  };
+
+  struct later
+  {
+    bool operator()(const event& lhs, const event& rhs) const noexcept
+    {
+      return lhs.time > rhs.time || (lhs.time == rhs.time && lhs.order > rhs.order);
+    }
+  };
+
+  loopback_bus bus_;
+  mutable std::mutex mutex_;
+  std::priority_queue<event, std::vector<event>, later> events_;
+  std::atomic<int64_t> now_{};
+  uint64_t order_{};
+};
+}
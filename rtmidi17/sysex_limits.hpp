@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace rtmidi
+{
+/**********************************************************************/
+/*! \class sysex_limits
+    \brief Bounds the reassembly of the sysex messages received in
+    several parts: see midi_in::set_sysex_limits().
+
+    Each source sending to an input is reassembled separately, so that
+    sysex from different senders do not mix.
+*/
+/**********************************************************************/
+struct sysex_limits
+{
+  //! Sysex longer than this are dropped as a whole.
+  std::size_t max_size{1 << 20};
+
+  //! A sysex whose next part does not come within this delay, in
+  //! microseconds, is dropped. Zero waits forever.
+  int64_t timeout{1000000};
+
+  //! If not zero, sysex are delivered in chunks of about this size as
+  //! they are received, rather than reassembled: the first chunk starts
+  //! with 0xF0, the last one ends with 0xF7. max_size then does not apply,
+  //! which suits very large dumps.
+  std::size_t chunk_size{0};
+};
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <rtmidi17/reader.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace rtmidi
+{
+/**********************************************************************/
+/*! \class tempo_map
+    \brief Converts between ticks and time following the tempo changes
+    of a MIDI file.
+
+    The reader must have been created with absolute ticks
+    (reader{true}). Times are in microseconds since tick 0.
+*/
+/**********************************************************************/
+class tempo_map
+{
+public:
+  tempo_map() = default;
+
+  explicit tempo_map(const reader& song)
+      : ticksPerBeat_{song.ticksPerBeat > 0 ? song.ticksPerBeat : 480.}
+  {
+    std::vector<std::pair<int, int>> changes; // tick, microseconds per quarter note
+    for (const auto& track : song.tracks)
+    {
+      for (const auto& e : track)
+      {
+        if (e.m.bytes.size() == 6 && e.m.is_meta_event()
+            && e.m.get_meta_event_type() == meta_event_type::TEMPO_CHANGE)
+        {
+          changes.emplace_back(
+              e.tick, (e.m.bytes[3] << 16) | (e.m.bytes[4] << 8) | e.m.bytes[5]);
+        }
+      }
+    }
+    std::stable_sort(changes.begin(), changes.end(), [](const auto& lhs, const auto& rhs) {
+      return lhs.first < rhs.first;
+    });
+
+    segments_.clear();
+    segments_.push_back({0., 0., 500000. / ticksPerBeat_});
+    for (const auto& [tick, mpqn] : changes)
+    {
+      if (mpqn <= 0)
+        continue;
+
+      const auto& last = segments_.back();
+      const double time = last.time + (tick - last.tick) * last.usPerTick;
+      if (tick == last.tick)
+        segments_.back().usPerTick = mpqn / ticksPerBeat_;
+      else
+        segments_.push_back({double(tick), time, mpqn / ticksPerBeat_});
+    }
+  }
+
+  double ticks_per_beat() const noexcept
+  {
+    return ticksPerBeat_;
+  }
+
+  //! Time of a tick, in microseconds
+  double time_at(double tick) const noexcept
+  {
+    const auto& s = *std::prev(std::upper_bound(
+        segments_.begin() + 1, segments_.end(), tick,
+        [](double t, const segment& seg) { return t < seg.tick; }));
+    return s.time + (tick - s.tick) * s.usPerTick;
+  }
+
+  //! Tick at a time in microseconds
+  double tick_at(double time) const noexcept
+  {
+    const auto& s = *std::prev(std::upper_bound(
+        segments_.begin() + 1, segments_.end(), time,
+        [](double t, const segment& seg) { return t < seg.time; }));
+    return s.tick + (time - s.time) / s.usPerTick;
+  }
+
+  //! Tempo at a tick, in quarter notes per minute
+  double tempo_at(double tick) const noexcept
+  {
+    const auto& s = *std::prev(std::upper_bound(
+        segments_.begin() + 1, segments_.end(), tick,
+        [](double t, const segment& seg) { return t < seg.tick; }));
+    return 60e6 / (s.usPerTick * ticksPerBeat_);
+  }
+
+private:
+  struct segment
+  {
+    double tick;
+    double time;
+    double usPerTick;
+  };
+
+  double ticksPerBeat_{480.};
+  std::vector<segment> segments_{{0., 0., 500000. / 480.}};
+};
+}
@@ -0,0 +1,76 @@
+#if !defined(RTMIDI17_HEADER_ONLY)
+#  include <rtmidi17/trace.hpp>
+#endif
+
+#if defined(RTMIDI17_TRACING)
+#  include <mutex>
+#  include <ostream>
+#  include <vector>
+
+namespace rtmidi::trace
+{
+namespace detail
+{
+// The buffers outlive their threads, so that they can still be exported.
+struct registry
+{
+  std::mutex mutex;
+  std::vector<std::shared_ptr<thread_buffer>> buffers;
+};
+
+RTMIDI17_INLINE registry& get_registry()
+{
+  static registry r;
+  return r;
+}
+}
+
+RTMIDI17_INLINE
+thread_buffer::thread_buffer(uint32_t id) : spans_{std::make_unique<slot[]>(capacity)}, id_{id}
+{
+}
+
+RTMIDI17_INLINE
+thread_buffer& this_thread_buffer()
+{
+  thread_local const std::shared_ptr<thread_buffer> buffer = [] {
+    auto& r = detail::get_registry();
+    std::lock_guard<std::mutex> lock{r.mutex};
+    auto b = std::make_shared<thread_buffer>(uint32_t(r.buffers.size() + 1));
+    r.buffers.push_back(b);
+    return b;
+  }();
+  return *buffer;
+}
+
+RTMIDI17_INLINE
+void write_chrome_trace(std::ostream& out)
+{
+  auto& r = detail::get_registry();
+  std::vector<std::shared_ptr<thread_buffer>> buffers;
+  {
+    std::lock_guard<std::mutex> lock{r.mutex};
+    buffers = r.buffers;
+  }
+
+  // Complete events ("X"), with times in microseconds
+  const auto flags = out.flags();
+  out.setf(std::ios::fixed);
+  const auto precision = out.precision(3);
+  out << "{\"traceEvents\":[";
+  bool first = true;
+  for (const auto& b : buffers)
+  {
+    b->read([&](const thread_buffer::span& s) {
+      out << (first ? "\n" : ",\n") << "{\"name\":\"" << s.name
+          << "\",\"cat\":\"rtmidi17\",\"ph\":\"X\",\"pid\":1,\"tid\":" << b->id()
+          << ",\"ts\":" << s.begin * 1e-3 << ",\"dur\":" << (s.end - s.begin) * 1e-3 << "}";
+      first = false;
+    });
+  }
+  out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+  out.precision(precision);
+  out.flags(flags);
+}
+}
+#endif
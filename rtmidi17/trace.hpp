@@ -0,0 +1,158 @@
+#pragma once
+#include <rtmidi17/rtmidi17.hpp>
+
+//! RTMIDI17_TRACE_SCOPE(name) marks the hot paths of the library: the
+//! input handlers of the back-ends, the input queue, send_message and the
+//! parsing of MIDI files. A hook measures the time until the end of its
+//! enclosing scope; name must be a string literal.
+//!
+//! By default hooks compile to nothing. With RTMIDI17_TRACING, they record
+//! spans in a buffer per thread, exported with
+//! rtmidi::trace::write_chrome_trace(). Applications can also define
+//! RTMIDI17_TRACE_SCOPE themselves before including the library, to feed
+//! another profiler.
+#if !defined(RTMIDI17_TRACE_SCOPE)
+#  if defined(RTMIDI17_TRACING)
+#    define RTMIDI17_TRACE_CAT_(a, b) a##b
+#    define RTMIDI17_TRACE_CAT(a, b) RTMIDI17_TRACE_CAT_(a, b)
+#    define RTMIDI17_TRACE_SCOPE(name) \
+      const ::rtmidi::trace::scope RTMIDI17_TRACE_CAT(rtmidi17_trace_, __LINE__){name}
+#  else
+#    define RTMIDI17_TRACE_SCOPE(name) \
+      do                               \
+      {                                \
+      } while (0)
+#  endif
+#endif
+
+#if defined(RTMIDI17_TRACING)
+#  include <algorithm>
+#  include <atomic>
+#  include <chrono>
+#  include <cstdint>
+#  include <iosfwd>
+#  include <memory>
+
+namespace rtmidi::trace
+{
+/**********************************************************************/
+/*! \class thread_buffer
+    \brief The last spans recorded by a thread.
+
+    Only the thread which owns the buffer writes to it, without lock:
+    the oldest spans are overwritten when it is full. Other threads can
+    read it at any time; spans overwritten while they are read are
+    skipped.
+*/
+/**********************************************************************/
+class RTMIDI17_EXPORT thread_buffer
+{
+public:
+  static constexpr uint64_t capacity = 1 << 16;
+
+  struct span
+  {
+    const char* name{};
+    int64_t begin{}; // in nanoseconds, on the steady clock
+    int64_t end{};
+  };
+
+  explicit thread_buffer(uint32_t id);
+
+  uint32_t id() const noexcept
+  {
+    return id_;
+  }
+
+  void record(const char* name, int64_t begin, int64_t end) noexcept
+  {
+    const auto i = count_.load(std::memory_order_relaxed);
+    started_.store(i + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto& s = spans_[i & (capacity - 1)];
+    s.name.store(name, std::memory_order_relaxed);
+    s.begin.store(begin, std::memory_order_relaxed);
+    s.end.store(end, std::memory_order_relaxed);
+    count_.store(i + 1, std::memory_order_release);
+  }
+
+  //! Calls f(const span&) for each span still in the buffer, oldest first.
+  template <typename F>
+  void read(F&& f) const
+  {
+    const auto end = count_.load(std::memory_order_acquire);
+    auto first = end > capacity ? end - capacity : 0;
+
+    auto copy = std::make_unique<span[]>(end - first);
+    for (auto i = first; i < end; i++)
+    {
+      const auto& s = spans_[i & (capacity - 1)];
+      copy[i - first] = {s.name.load(std::memory_order_relaxed),
+                         s.begin.load(std::memory_order_relaxed),
+                         s.end.load(std::memory_order_relaxed)};
+    }
+
+    // Skip the spans which the owner started to overwrite meanwhile.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const auto started = started_.load(std::memory_order_relaxed);
+    const auto valid = started > capacity ? started - capacity : 0;
+    for (auto i = std::max(first, valid); i < end; i++)
+      f(copy[i - first]);
+  }
+
+private:
+  struct slot
+  {
+    std::atomic<const char*> name{};
+    std::atomic<int64_t> begin{};
+    std::atomic<int64_t> end{};
+  };
+
+  std::unique_ptr<slot[]> spans_;
+  std::atomic<uint64_t> count_{};
+  std::atomic<uint64_t> started_{};
+  uint32_t id_{};
+};
+
+//! Time in nanoseconds on the steady clock
+inline int64_t now() noexcept
+{
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+//! The buffer of the calling thread. The first call from a thread
+//! allocates it, and takes a lock to register it.
+RTMIDI17_EXPORT thread_buffer& this_thread_buffer();
+
+//! Writes the spans of all the threads, including those which ended, in
+//! the Chrome trace event format, for chrome://tracing or Perfetto.
+RTMIDI17_EXPORT void write_chrome_trace(std::ostream& out);
+
+//! Records the time spent until the end of the enclosing scope.
+class scope
+{
+public:
+  explicit scope(const char* name) noexcept : name_{name}, begin_{now()}
+  {
+  }
+
+  ~scope()
+  {
+    this_thread_buffer().record(name_, begin_, now());
+  }
+
+  scope(const scope&) = delete;
+  scope& operator=(const scope&) = delete;
+
+private:
+  const char* name_;
+  int64_t begin_;
+};
+}
+#endif
+
+#if defined(RTMIDI17_HEADER_ONLY)
+#  include <rtmidi17/trace.cpp>
+#endif
@@ -25,11 +25,21 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
 #include <cstdint>
+#include <ostream>
 #include <rtmidi17/message.hpp>
 #include <vector>
 
 namespace rtmidi
 {
+namespace util
+{
+RTMIDI17_INLINE std::ostream& write_uint16_be(std::ostream& out, uint16_t value);
+RTMIDI17_INLINE std::ostream& write_uint32_be(std::ostream& out, uint32_t value);
+
+//! Appends a value to a MIDI file buffer as a variable-length quantity.
+RTMIDI17_INLINE void write_variable_length(uint32_t aValue, std::vector<uint8_t>& outdata);
+}
+
 class writer
 {
 public:
@@ -0,0 +1,188 @@
+//*****************************************//
+//  jackclock.cpp
+//
+//  Checks the JACK transport-locked MIDI clock: a jack_clock is
+//  connected to a JACK MIDI input of the same program, the transport
+//  is started, the tempo is changed and the transport relocated while
+//  it rolls, and the received clocks are compared to the expected
+//  tempos. Start a JACK server first, for instance with the dummy
+//  driver: jackd -d dummy -r 48000 -p 256
+//
+//  Registered with ctest when JACK is found. Returns EXIT_FAILURE if a
+//  clock drifts by more than a frame from the grid of its tempo, if the
+//  number of clocks does not match the tempos, or if the start, stop,
+//  continue and song position messages are not the expected ones, and
+//  77, the skip code of ctest, when no JACK server is running.
+//
+//*****************************************//
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <rtmidi17/jack_clock.hpp>
+#include <rtmidi17/rtmidi17.hpp>
+#include <thread>
+#include <vector>
+
+int main()
+try
+{
+  using namespace std::literals;
+  const double bpm = 150.;
+  const double changed = 100.;
+  // Microseconds per clock
+  const auto interval = [](double tempo) { return 60. / (tempo * 24.) * 1e6; };
+
+  // Do not start a server just for the test. The probe client stays open
+  // to relocate the transport.
+  jack_status_t status{};
+  auto probe = jack_client_open("RtMidi17 Clock Probe", JackNoStartServer, &status);
+  if (!probe)
+  {
+    std::cout << "No JACK server running: skipped." << std::endl;
+    return 77;
+  }
+  const double rate = jack_get_sample_rate(probe);
+  // One frame at 48kHz is ~21 us.
+  const double tolerance = 1.2 * 1e6 / rate;
+
+  struct received
+  {
+    rtmidi::message_type type;
+    int64_t time;
+    int song_position;
+  };
+  std::vector<received> events;
+  events.reserve(4096);
+
+  rtmidi::midi_in midiin{rtmidi::API::UNIX_JACK, "RtMidi17 Clock Test"};
+  midiin.ignore_types(false, false, false);
+  midiin.set_callback([&](const rtmidi::message& message) {
+    if (events.size() == events.capacity())
+      return;
+    const auto type = message.get_message_type();
+    int position = -1;
+    if (type == rtmidi::message_type::SONG_POS_POINTER && message.size() == 3)
+      position = message[1] | (message[2] << 7);
+    events.push_back({type, message.absolute_time, position});
+  });
+  midiin.open_virtual_port("clock in");
+
+  rtmidi::jack_clock clock{"RtMidi17 Clock Test", "clock out"};
+  clock.set_tempo(bpm);
+  clock.connect("RtMidi17 Clock Test:clock in");
+
+  // The relocation goes ten seconds ahead, at the changed tempo.
+  const auto before = 1s, after = 1s, relocated = 1s;
+  const jack_nframes_t target = jack_nframes_t(10. * rate);
+  jack_transport_locate(probe, 0);
+  std::this_thread::sleep_for(100ms);
+  clock.start_transport();
+  std::this_thread::sleep_for(before);
+  clock.set_tempo(changed);
+  std::this_thread::sleep_for(after);
+  jack_transport_locate(probe, target);
+  std::this_thread::sleep_for(relocated);
+  clock.stop_transport();
+  std::this_thread::sleep_for(200ms);
+  jack_client_close(probe);
+
+  bool ok = true;
+  auto check = [&](bool condition, const char* what) {
+    if (!condition)
+    {
+      std::cerr << "FAILED: " << what << std::endl;
+      ok = false;
+    }
+  };
+
+  // Each run of clocks at one tempo must stay on the grid of that tempo
+  // from its first clock: a frame of error at most, without accumulation.
+  // The interval which contains the tempo change is between both.
+  int starts = 0, continues = 0, stops = 0, clocks = 0, changes = 0;
+  int songPosition = -1;
+  double maxError = 0.;
+  int64_t anchor = 0, last = 0;
+  int count = 0;
+  double current = interval(bpm);
+  for (const auto& e : events)
+  {
+    switch (e.type)
+    {
+      case rtmidi::message_type::START:
+        starts++;
+        anchor = 0;
+        break;
+      case rtmidi::message_type::CONTINUE:
+        continues++;
+        anchor = 0;
+        break;
+      case rtmidi::message_type::STOP:
+        stops++;
+        break;
+      case rtmidi::message_type::SONG_POS_POINTER:
+        songPosition = e.song_position;
+        break;
+      case rtmidi::message_type::TIME_CLOCK:
+      {
+        clocks++;
+        if (anchor != 0)
+        {
+          const double error = e.time - anchor - (count + 1) * current;
+          if (current == interval(bpm) && std::abs(error) > tolerance)
+          {
+            const double delta = e.time - last;
+            check(
+                delta > interval(bpm) - tolerance && delta < interval(changed) + tolerance,
+                "interval across the tempo change");
+            current = interval(changed);
+            changes++;
+            anchor = 0;
+          }
+        }
+        if (anchor == 0)
+        {
+          anchor = e.time;
+          count = 0;
+        }
+        else
+        {
+          count++;
+          maxError = std::max(maxError, std::abs(e.time - anchor - count * current));
+        }
+        last = e.time;
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  std::cout << "Received " << clocks << " clocks, " << starts << " start, " << continues
+            << " continue, " << stops << " stop, song position " << songPosition
+            << ".\nMaximum drift from the tempo grid: " << maxError << " us" << std::endl;
+
+  // The transport starts, stops and relocates on cycle boundaries, and
+  // the tempo changes at the next one: allow a few clocks of difference,
+  // which is still far from any other tempo.
+  const auto seconds = [](auto d) { return std::chrono::duration<double>(d).count(); };
+  const double expectedClocks
+      = (seconds(before) * bpm + seconds(after + relocated) * changed) / 60. * 24.;
+  check(starts == 1, "one start message");
+  check(continues == 1, "one continue message after the relocation");
+  check(stops == 2, "one stop message for the relocation, one at the end");
+  check(changes == 1, "one tempo change");
+  check(std::abs(clocks - expectedClocks) <= 6., "number of clocks for the tempos");
+
+  // After the relocation, the position comes from the frame and the tempo.
+  const int expectedPosition = int(target * changed / (60. * rate) * 4.);
+  check(std::abs(songPosition - expectedPosition) <= 1, "song position after the relocation");
+  check(maxError < tolerance, "clocks within a frame of the tempo grid");
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+catch (const rtmidi::midi_exception& error)
+{
+  std::cerr << error.what() << std::endl;
+  return EXIT_FAILURE;
+}
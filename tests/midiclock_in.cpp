@@ -12,6 +12,7 @@
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <rtmidi17/clock_follower.hpp>
 #include <rtmidi17/rtmidi17.hpp>
 #include <thread>
 
@@ -68,8 +69,10 @@ try
   // Set our callback function.  This should be done immediately after
   // opening the port to avoid having incoming messages written to the
   // queue instead of sent to the callback function.
-  unsigned int clock_count = 0;
+  rtmidi::clock_follower follower;
   midiin.set_callback([&](const rtmidi::message& message) {
+    follower.process(message);
+
     // Ignore longer messages
     if (message.size() != 1)
       return;
@@ -83,15 +86,13 @@ try
       std::cout << "STOP received" << std::endl;
     if (msg == 0xF8)
     {
-      if (++clock_count == 24)
+      const auto state = follower.state();
+      if (state.locked && state.playing && state.position % 24 == 0)
       {
-        double bpm = 60.0 / 24.0 / message.timestamp;
-        std::cout << "One beat, estimated BPM = " << bpm << std::endl;
-        clock_count = 0;
+        std::cout << "One beat at quarter note " << state.position / 24
+                  << ", estimated BPM = " << state.bpm << std::endl;
       }
     }
-    else
-      clock_count = 0;
   });
 
   // Don't ignore sysex, timing, or active sensing messages.
@@ -12,6 +12,7 @@
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <rtmidi17/clock_generator.hpp>
 #include <rtmidi17/rtmidi17.hpp>
 #include <thread>
 
@@ -66,56 +67,44 @@ try
   if (choosePort(midiout, "output") == false)
     return 0;
 
-  // Period in ms = 100 BPM
-  // 100*24 ticks / 1 minute, so (60*1000) / (100*24) = 25 ms / tick
-  int sleep_ms = 25;
-  std::cout << "Generating clock at " << (60.0 / 24.0 / sleep_ms * 1000.0) << " BPM." << std::endl;
+  // 100 BPM: 100*24 ticks / 1 minute, so (60*1000) / (100*24) = 25 ms / tick
+  rtmidi::clock_generator clock{midiout, 100.};
+  std::cout << "Generating clock at " << clock.get_tempo() << " BPM." << std::endl;
 
-  // Send out a series of MIDI clock messages.
-  // MIDI start
-  std::vector<unsigned char> message;
-  message.push_back(0xFA);
-  midiout.send_message(message);
-  std::cout << "MIDI start" << std::endl;
+  // Four beats last 2.4 seconds at 100 BPM.
+  const auto bar = 2400ms;
 
+  clock.start();
+  std::cout << "MIDI start" << std::endl;
   for (int j = 0; j < 8; j++)
   {
     if (j > 0)
     {
-      // MIDI continue
-      message.clear();
-      message.push_back(0xFB);
-      midiout.send_message(message);
+      clock.resume();
       std::cout << "MIDI continue" << std::endl;
     }
 
-    for (int k = 0; k < 96; k++)
-    {
-      // MIDI clock
-      message.clear();
-      message.push_back(0xF8);
-      midiout.send_message(message);
-      if (k % 24 == 0)
-        std::cout << "MIDI clock (one beat)" << std::endl;
-      std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms));
-    }
+    std::this_thread::sleep_for(bar);
 
-    // MIDI stop
-    message.clear();
-    message.push_back(0xFC);
-    midiout.send_message(message);
-    std::cout << "MIDI stop" << std::endl;
+    clock.stop();
+    std::cout << "MIDI stop at sixteenth " << clock.get_song_position() << std::endl;
     std::this_thread::sleep_for(500ms);
   }
 
-  // MIDI stop
-  message.clear();
-  message.push_back(0xFC);
-  midiout.send_message(message);
-  std::cout << "MIDI stop" << std::endl;
+  // Tempo ramp up to 140 BPM over two bars
+  clock.ramp_tempo(140., 8.);
+  clock.resume();
+  std::cout << "MIDI continue, ramping to 140 BPM" << std::endl;
+  std::this_thread::sleep_for(2 * bar);
+  clock.stop();
+  std::cout << "MIDI stop at " << clock.get_tempo() << " BPM" << std::endl;
 
   std::this_thread::sleep_for(500ms);
 
+  const auto stats = clock.get_stats();
+  std::cout << stats.ticks << " clocks sent, lateness (us): mean " << stats.mean_error
+            << ", stddev " << stats.stddev_error << ", max " << stats.max_error << std::endl;
+
   std::cout << "Done!" << std::endl;
 
   return 0;
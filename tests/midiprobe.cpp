@@ -17,7 +17,8 @@ try
   std::map<rtmidi::API, std::string> apiMap{
       {rtmidi::API::MACOSX_CORE, "OS-X CoreMidi"}, {rtmidi::API::WINDOWS_MM, "Windows MultiMedia"},
       {rtmidi::API::UNIX_JACK, "Jack Client"},     {rtmidi::API::LINUX_ALSA, "Linux ALSA"},
-      {rtmidi::API::DUMMY, "Dummy (no driver)"},
+      {rtmidi::API::LOOPBACK, "Loopback"},         {rtmidi::API::REPLAY, "File replay"},
+      {rtmidi::API::SIMULATED, "Simulated"},       {rtmidi::API::DUMMY, "Dummy (no driver)"},
   };
 
   auto apis = rtmidi::available_apis();